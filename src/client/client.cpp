@@ -1,6 +1,7 @@
 #include "../common/boot_screen.h"
 #include "../common/collision.h"
 #include "../common/data.h"
+#include "../common/entity_db.h"
 #include "../common/histogram.h"
 #include "../common/io.h"
 #include "../common/perf_timer.h"
@@ -129,6 +130,8 @@ int main(int argc, char *argv[])
 {
 #if _DEBUG
     dlb_CommonTests();
+    NetTests();
+    EntityDBTests();
 #endif
 
     Err err = RN_SUCCESS;
@@ -55,7 +55,6 @@ void ClientWorld::ApplySpawnEvent(const Msg_S_EntitySpawn &entitySpawn)
 
     entity->type      = entitySpawn.type;
     entity->spec      = entitySpawn.spec;
-    entity->name      = entitySpawn.name;
     entity->map_id    = entitySpawn.map_id;
     entity->position  = entitySpawn.position;
     entity->radius    = entitySpawn.radius;
@@ -65,6 +64,8 @@ void ClientWorld::ApplySpawnEvent(const Msg_S_EntitySpawn &entitySpawn)
     entity->hp_max    = entitySpawn.hp_max;
     entity->hp        = entitySpawn.hp;
     entity->sprite_id = entitySpawn.sprite_id;
+
+    entity->cold->name = entitySpawn.name;
 }
 void ClientWorld::ApplyStateInterpolated(Entity &entity,
     const GhostSnapshot &a, const GhostSnapshot &b, float alpha, float dt)
@@ -89,8 +90,8 @@ Err ClientWorld::CreateDialog(Entity &entity, uint16_t dialogId, const std::stri
 {
     entity.dialog_spawned_at = now;
     entity.dialog_id = dialogId;
-    entity.dialog_title = title;
-    entity.dialog_message = message;
+    entity.cold->dialog_title = title;
+    entity.cold->dialog_message = message;
     return RN_SUCCESS;
 }
 
@@ -180,7 +181,7 @@ void ClientWorld::UpdateLocalPlayer(GameClient &client, Entity &entity)
     histoData.cmdAccumForce = cmdAccumForce;
     UpdateLocalPlayerHisto(client, entity, histoData);
 }
-void ClientWorld::UpdateLocalGhost(GameClient &client, Entity &entity, uint16_t player_map_id)
+void ClientWorld::UpdateLocalGhost(GameClient &client, Entity &entity)
 {
     // TODO(dlb): Find snapshots nearest to (GetTime() - clientTimeDeltaVsServer)
     const double renderAt = client.ServerNow() - SV_TICK_DT;
@@ -212,9 +213,24 @@ void ClientWorld::UpdateLocalGhost(GameClient &client, Entity &entity, uint16_t
     }
 
     ApplyStateInterpolated(entity, *snapshotA, *snapshotB, alpha, client.frameDt);
+}
+void ClientWorld::UpdateHoveredEntity(uint16_t player_map_id)
+{
+    const Vector2 cursorWorldPos = GetScreenToWorld2D(GetMousePosition(), camera);
+    const Rectangle searchRect{
+        cursorWorldPos.x - SV_ENTITY_MAX_EXTENT,
+        cursorWorldPos.y - SV_ENTITY_MAX_EXTENT,
+        SV_ENTITY_MAX_EXTENT * 2,
+        SV_ENTITY_MAX_EXTENT * 2
+    };
+    entityDb->QueryRect(player_map_id, searchRect, nearbyEntities);
+
+    for (Entity *entityPtr : nearbyEntities) {
+        Entity &entity = *entityPtr;
+        if (!entity.type || entity.id == localPlayerEntityId) {
+            continue;
+        }
 
-    if (entity.map_id == player_map_id) {
-        const Vector2 cursorWorldPos = GetScreenToWorld2D(GetMousePosition(), camera);
         const Rectangle rect = entity.GetSpriteRect();
         bool hover = dlb_CheckCollisionPointRec(cursorWorldPos, rect);
         if (hover) {
@@ -262,18 +278,21 @@ void ClientWorld::UpdateEntities(GameClient &client)
         if (entity.id == localPlayerEntityId) {
             UpdateLocalPlayer(client, entity);
         } else {
-            UpdateLocalGhost(client, entity, player_map_id);
+            UpdateLocalGhost(client, entity);
         }
+        entityDb->UpdateSpatial(entity);
 
         bool newlySpawned = entity.spawned_at == client.now;
         UpdateSprite(entity, client.frameDt, newlySpawned);
 
-        const double duration = CL_DIALOG_DURATION_MIN + CL_DIALOG_DURATION_PER_CHAR * entity.dialog_message.size();
+        const double duration = CL_DIALOG_DURATION_MIN + CL_DIALOG_DURATION_PER_CHAR * entity.cold->dialog_message.size();
         if (entity.dialog_spawned_at && client.now - entity.dialog_spawned_at > duration) {
             entity.ClearDialog();
         }
     }
 
+    UpdateHoveredEntity(player_map_id);
+
     if (hoveredEntityId && hoveredEntityInRange) {
         Entity *hoveredEntity = entityDb->FindEntity(hoveredEntityId);
         if (hoveredEntity) {
@@ -547,10 +566,10 @@ void ClientWorld::DrawDialog(GameClient &client, Entity &entity, Vector2 bottomC
     const float marginBottom = 4.0f;
     const Vector2 bgPad{ 12, 8 };
 
-    const Vector2 titleSize = dlb_MeasureTextEx(font, CSTRS(entity.dialog_title));
+    const Vector2 titleSize = dlb_MeasureTextEx(font, CSTRS(entity.cold->dialog_title));
 
     DialogNodeList msgNodes{};
-    char *msgBuf = (char *)entity.dialog_message.c_str();
+    char *msgBuf = (char *)entity.cold->dialog_message.c_str();
     Err err = ParseMessage(msgBuf, msgNodes);
     if (err) {
         DialogNode errNode{};
@@ -619,7 +638,7 @@ void ClientWorld::DrawDialog(GameClient &client, Entity &entity, Vector2 bottomC
     dlb_DrawNPatch(bgRect);
     //DrawRectangleRounded(msgBgRect, 0.2f, 6, Fade(BLACK, 0.5));
     //DrawRectangleRoundedLines(msgBgRect, 0.2f, 6, 1.0f, RAYWHITE);
-    dlb_DrawTextEx(font, CSTRS(entity.dialog_title), titlePos, GOLD);
+    dlb_DrawTextEx(font, CSTRS(entity.cold->dialog_title), titlePos, GOLD);
 
     float separatorY = titlePos.y + titleSize.y + bgPad.y / 2;
     DrawLine(
@@ -777,12 +796,12 @@ void ClientWorld::DrawHUDEntityHoverInfo(void)
         DrawRectangleRec(hpBar, ColorBrightness(MAROON, -0.4));
     }
 
-    Vector2 labelSize = dlb_MeasureTextShadowEx(fntMedium, CSTRS(e_hovered.name));
+    Vector2 labelSize = dlb_MeasureTextShadowEx(fntMedium, CSTRS(e_hovered.cold->name));
     Vector2 labelPos{
         floorf(hpBarBg.x + hpBarBg.width / 2 - labelSize.x / 2),
         floorf(hpBarBg.y + hpBarBg.height / 2 - labelSize.y / 2)
     };
-    dlb_DrawTextShadowEx(fntMedium, e_hovered.name.c_str(), e_hovered.name.size(), labelPos, WHITE);
+    dlb_DrawTextShadowEx(fntMedium, e_hovered.cold->name.c_str(), e_hovered.cold->name.size(), labelPos, WHITE);
 }
 void ClientWorld::DrawHUDSignEditor(void)
 {
@@ -4,7 +4,7 @@
 #include "../common/input_command.h"
 
 struct Msg_S_EntitySpawn;
-struct Msg_S_EntitySnapshot;
+struct Msg_S_WorldSnapshot;
 struct GameClient;
 
 struct Controller {
@@ -221,6 +221,7 @@ struct ClientWorld {
     uint32_t localPlayerEntityId{};
     uint32_t hoveredEntityId{};   // mouse is over entity
     bool hoveredEntityInRange{};  // player is close enough to interact
+    std::vector<Entity *> nearbyEntities{};  // scratch for EntityDB spatial queries
 
     Title title{};
     Spinner spinner{};
@@ -252,7 +253,8 @@ private:
     void UpdateMap(GameClient &client, Tilemap &map);
     void UpdateLocalPlayerHisto(GameClient &client, Entity &entity, HistoData &histoData);
     void UpdateLocalPlayer(GameClient &client, Entity &entity);
-    void UpdateLocalGhost(GameClient &client, Entity &entity, uint16_t player_map_id);
+    void UpdateLocalGhost(GameClient &client, Entity &entity);
+    void UpdateHoveredEntity(uint16_t player_map_id);
     void UpdateEntities(GameClient &client);
     void UpdateCamera(GameClient &client);
     void UpdateHUDSpinner(void);
@@ -62,6 +62,7 @@ void GameClient::SendInput(const Controller &controller)
     if (yj_client->CanSendMessage(MSG_C_INPUT_COMMANDS)) {
         Msg_C_InputCommands *msg = (Msg_C_InputCommands *)yj_client->CreateMessage(MSG_C_INPUT_COMMANDS);
         if (msg) {
+            msg->last_snapshot_acked = lastSnapshotAcked;
             msg->cmdQueue = controller.cmdQueue;
             yj_client->SendMessage(CHANNEL_U_INPUT_COMMANDS, msg);
         } else {
@@ -140,14 +141,6 @@ void GameClient::ProcessMsg(Msg_S_EntitySay &msg)
         printf("[game_client] Failed to create dialog. Could not find entity id %u.\n", msg.entity_id);
     }
 }
-void GameClient::ProcessMsg(Msg_S_EntitySnapshot &msg)
-{
-    Entity *entity = entityDb->FindEntity(msg.entity_id);
-    if (entity) {
-        GhostSnapshot ghostSnapshot{ msg };
-        entity->ghost->push(ghostSnapshot);
-    }
-}
 void GameClient::ProcessMsg(Msg_S_EntitySpawn &msg)
 {
     //printf("[ENTITY_SPAWN] id=%u mapId=%u\n", msg->entity_id, msg->map_id);
@@ -170,11 +163,7 @@ void GameClient::ProcessMsg(Msg_S_TileChunk &msg)
     assert(map.id = msg.map_id);
 
     if (!map.width) {
-        map.width = msg.map_w;
-        map.height = msg.map_h;
-        for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-            map.layers[layer].resize(map.width * map.height);
-        }
+        map.Resize(msg.map_w, msg.map_h);
     } else {
         // map changed size.. uhhhh wot?
         assert(map.width == msg.map_w);
@@ -188,45 +177,169 @@ void GameClient::ProcessMsg(Msg_S_TileChunk &msg)
     assert(block_size == msg.smol_size);
 
     int chunk_beeg_bytes{};
-    uint8_t *chunk_beeg{};
 #if SV_COMPRESS_TILE_CHUNK_WITH_LZ4
-    chunk_beeg = (uint8_t *)MemAlloc(msg.beeg_size);
-    chunk_beeg_bytes = LZ4_decompress_safe((char *)block, (char *)chunk_beeg, block_size, msg.beeg_size);
+    tileChunkEncoded.resize(msg.beeg_size);
+    chunk_beeg_bytes = LZ4_decompress_safe((char *)block, (char *)tileChunkEncoded.data(), block_size, msg.beeg_size);
 #else
-    chunk_beeg = (uint8_t *)DecompressData(block, block_size, &chunk_beeg_bytes);
+    uint8_t *chunk_beeg = DecompressData(block, block_size, &chunk_beeg_bytes);
+    tileChunkEncoded.assign(chunk_beeg, chunk_beeg + chunk_beeg_bytes);
+    MemFree(chunk_beeg);
 #endif
     assert(chunk_beeg_bytes == msg.beeg_size);
 
-    int index = 0;
-    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-        for (uint32_t ty = msg.y; ty < msg.w; ty++) {
-            for (uint32_t tx = msg.x; tx < msg.h; tx++) {
-                map.Set((TileLayerType)layer, msg.x + tx, msg.y + ty, ((uint16_t *)chunk_beeg)[index], 0);
-                index++;
-            }
-        }
+    tileChunkTiles.resize((size_t)TILE_LAYER_COUNT * msg.w * msg.h);
+    if (!tileCodec.Decode(tileChunkEncoded.data(), tileChunkEncoded.size(), msg.w, msg.h, tileChunkTiles.data())) {
+        assert(!"malformed tile chunk");
+        printf("[game_client] malformed tile chunk at %u, %u on map %u\n", msg.x, msg.y, msg.map_id);
+        return;
     }
 
-    MemFree(chunk_beeg);
+    // NOTE(dlb): Doesn't autotile, the server already did, and the neighboring chunks might not be
+    // here yet
+    map.SetChunkTiles(msg.x, msg.y, msg.w, msg.h, tileChunkTiles.data());
 }
-void GameClient::ProcessMsg(Msg_S_TileUpdate &msg)
+void GameClient::ProcessMsg(Msg_S_TileDelta &msg)
 {
     Tilemap &map = world->FindOrLoadMap(msg.map_id);
-    assert(map.id = msg.map_id);
+    assert(map.id == msg.map_id);
+
+    // NOTE(dlb): Server only sends deltas for chunks we already have
+    assert(map.width);
+    if (!map.width) {
+        return;
+    }
+
+    const int block_size = msg.GetBlockSize();
+    if (block_size != (msg.run_count * 2 + msg.tile_count * TILE_LAYER_COUNT) * (int)sizeof(uint16_t)) {
+        assert(!"malformed tile delta");
+        printf("[game_client] malformed tile delta at %u, %u on map %u, block is %d bytes\n", msg.x, msg.y, msg.map_id, block_size);
+        return;
+    }
+    if (msg.x % TileChunk::WIDTH || msg.y % TileChunk::WIDTH || msg.x >= map.width || msg.y >= map.height) {
+        assert(!"malformed tile delta");
+        printf("[game_client] malformed tile delta at %u, %u on map %u, not a chunk on the map\n", msg.x, msg.y, msg.map_id);
+        return;
+    }
+
+    const uint16_t *runs = (uint16_t *)msg.GetBlockData();
+    const uint16_t *tile_ids = runs + msg.run_count * 2;
+
+    // Every run has to stay inside the chunk (clipped to the map), and they have to add up to
+    // tile_count, before we touch anything
+    const uint32_t chunk_w = (uint32_t)MIN(map.width - msg.x, TileChunk::WIDTH);
+    const uint32_t chunk_h = (uint32_t)MIN(map.height - msg.y, TileChunk::WIDTH);
+    uint32_t run_tiles = 0;
+    for (uint32_t run = 0; run < msg.run_count; run++) {
+        const uint32_t start = runs[run * 2];
+        const uint32_t count = runs[run * 2 + 1];
+        const uint32_t last = start + count - 1;
+        const bool oneRow = start / TileChunk::WIDTH == last / TileChunk::WIDTH;
+        if (!count || last >= TileChunk::TILE_COUNT || last / TileChunk::WIDTH >= chunk_h ||
+            (oneRow ? last % TileChunk::WIDTH >= chunk_w : chunk_w < TileChunk::WIDTH)) {
+            run_tiles = UINT32_MAX;
+            break;
+        }
+        run_tiles += count;
+    }
+    if (run_tiles != msg.tile_count) {
+        assert(!"malformed tile delta");
+        printf("[game_client] malformed tile delta at %u, %u on map %u, bad runs\n", msg.x, msg.y, msg.map_id);
+        return;
+    }
+
     for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-        map.Set((TileLayerType)layer, msg.x, msg.y, msg.tile_ids[layer], 0);
+        for (uint32_t run = 0; run < msg.run_count; run++) {
+            const uint16_t start = runs[run * 2];
+            const uint16_t count = runs[run * 2 + 1];
+            for (uint32_t tileIdx = start; tileIdx < (uint32_t)start + count; tileIdx++) {
+                const uint16_t x = msg.x + tileIdx % TileChunk::WIDTH;
+                const uint16_t y = msg.y + tileIdx / TileChunk::WIDTH;
+                map.Set((TileLayerType)layer, x, y, *tile_ids, 0, false);
+                tile_ids++;
+            }
+        }
     }
 }
 void GameClient::ProcessMsg(Msg_S_TitleShow &msg)
 {
     world->title.Show(msg.text, now);
 }
+void GameClient::ProcessMsg(Msg_S_WorldSnapshot &msg)
+{
+    // Already have a newer snapshot, this is useless now
+    if (msg.tick <= lastSnapshotAcked) {
+        return;
+    }
+
+    EntitySnapshotFrame *baseline = 0;
+    if (msg.baseline_tick) {
+        baseline = FindSnapshotFrame(snapshotHistory, msg.baseline_tick);
+        if (!baseline) {
+            // Don't have the baseline this was encoded against anymore, can't decode it
+            return;
+        }
+    }
+
+    // Unpack all of the records before touching anything, a truncated snapshot is no snapshot
+    snapshotRecords.resize(msg.entity_count);
+    if (msg.entity_count) {
+        if (!msg.GetBlockData()) {
+            printf("[game_client] world snapshot %u has %u entity records but no block\n", msg.tick, msg.entity_count);
+            return;
+        }
+        yojimbo::ReadStream stream{ yojimbo::GetDefaultAllocator(), msg.GetBlockData(), msg.GetBlockSize() };
+        for (EntitySnapshotRecord &record : snapshotRecords) {
+            record = {};
+            if (!record.Serialize(stream, msg.bounds)) {
+                printf("[game_client] failed to read entity records of world snapshot %u\n", msg.tick);
+                return;
+            }
+        }
+    }
+
+    // Apply the deltas to the baseline. Records are sent most important first, Merge wants them
+    // in id order.
+    std::sort(snapshotRecords.begin(), snapshotRecords.end(),
+        [](const EntitySnapshotRecord &a, const EntitySnapshotRecord &b) { return a.entity_id < b.entity_id; }
+    );
+    EntitySnapshotFrame frame{};
+    frame.tick = msg.tick;
+    frame.Merge(baseline, snapshotRecords.data(), snapshotRecords.size());
+
+    bool sawLocalPlayer = false;
+    for (EntitySnapshotRecord &record : snapshotRecords) {
+        if (record.removed) {
+            continue;
+        }
+
+        const EntityNetState *state = frame.Find(record.entity_id);
+        Entity *entity = entityDb->FindEntity(record.entity_id);
+        if (state && entity) {
+            GhostSnapshot ghostSnapshot{ msg, *state };
+            entity->ghost->push(ghostSnapshot);
+        }
+        sawLocalPlayer |= record.entity_id == world->localPlayerEntityId;
+    }
+
+    // Our player didn't change, but we still need the input ack for reconciliation
+    if (!sawLocalPlayer) {
+        const EntityNetState *state = frame.Find(world->localPlayerEntityId);
+        Entity *entity = entityDb->FindEntity(world->localPlayerEntityId);
+        if (state && entity) {
+            GhostSnapshot ghostSnapshot{ msg, *state };
+            entity->ghost->push(ghostSnapshot);
+        }
+    }
+
+    snapshotHistory.push(frame);
+    lastSnapshotAcked = frame.tick;
+}
 void GameClient::ProcessMessages(void)
 {
     for (int channelIdx = 0; channelIdx < CHANNEL_COUNT; channelIdx++) {
         yojimbo::Message *yjMsg = yj_client->ReceiveMessage(channelIdx);
         while (yjMsg) {
-            if (yjMsg->GetType() != MSG_S_ENTITY_SNAPSHOT) {
+            if (yjMsg->GetType() != MSG_S_WORLD_SNAPSHOT) {
                 printf("[game_client] RECV msgId=%d msgType=%s", yjMsg->GetId(), MsgTypeStr((MsgType)yjMsg->GetType()));
                 if (yjMsg->GetType() == MSG_S_ENTITY_SPAWN) {
                     const auto &spawn = *(Msg_S_EntitySpawn*)yjMsg;
@@ -238,11 +351,11 @@ void GameClient::ProcessMessages(void)
                 case MSG_S_CLOCK_SYNC:      ProcessMsg(*(Msg_S_ClockSync      *)yjMsg); break;
                 case MSG_S_ENTITY_DESPAWN:  ProcessMsg(*(Msg_S_EntityDespawn  *)yjMsg); break;
                 case MSG_S_ENTITY_SAY:      ProcessMsg(*(Msg_S_EntitySay      *)yjMsg); break;
-                case MSG_S_ENTITY_SNAPSHOT: ProcessMsg(*(Msg_S_EntitySnapshot *)yjMsg); break;
                 case MSG_S_ENTITY_SPAWN:    ProcessMsg(*(Msg_S_EntitySpawn    *)yjMsg); break;
                 case MSG_S_TILE_CHUNK:      ProcessMsg(*(Msg_S_TileChunk      *)yjMsg); break;
-                case MSG_S_TILE_UPDATE:     ProcessMsg(*(Msg_S_TileUpdate     *)yjMsg); break;
+                case MSG_S_TILE_DELTA:      ProcessMsg(*(Msg_S_TileDelta      *)yjMsg); break;
                 case MSG_S_TITLE_SHOW:      ProcessMsg(*(Msg_S_TitleShow      *)yjMsg); break;
+                case MSG_S_WORLD_SNAPSHOT:  ProcessMsg(*(Msg_S_WorldSnapshot  *)yjMsg); break;
             }
             yj_client->ReleaseMessage(yjMsg);
             yjMsg = yj_client->ReceiveMessage(channelIdx);
@@ -284,6 +397,8 @@ void GameClient::Update(void)
 void GameClient::Stop(void)
 {
     yj_client->Disconnect();
+    snapshotHistory = {};
+    lastSnapshotAcked = 0;
     clientTimeDeltaVsServer = 0;
     netTickAccum = 0;
     lastNetTick = 0;
@@ -2,6 +2,7 @@
 #include "../common/common.h"
 #include "../common/input_command.h"
 #include "../common/net/net.h"
+#include "../common/tile_codec.h"
 #include "client_world.h"
 #include "menu.h"
 #include "todo.h"
@@ -15,6 +16,13 @@ struct GameClient {
     double now{};                      // current time for this frame
     uint64_t frame{};
 
+    SnapshotHistory snapshotHistory{};  // entity state as of recent snapshots, baselines for deltas
+    uint32_t lastSnapshotAcked{};       // newest snapshot tick we've received in full
+    std::vector<EntitySnapshotRecord> snapshotRecords{};  // scratch for unpacking world snapshots
+    TileCodec tileCodec{};
+    std::vector<uint8_t> tileChunkEncoded{};  // scratch for unpacking tile chunks
+    std::vector<uint16_t> tileChunkTiles{};
+
     double frameStart{};
     double frameDt{};
     double frameDtSmooth = 60;
@@ -52,11 +60,11 @@ struct GameClient {
     void ProcessMsg(Msg_S_ClockSync &msg);
     void ProcessMsg(Msg_S_EntityDespawn &msg);
     void ProcessMsg(Msg_S_EntitySay &msg);
-    void ProcessMsg(Msg_S_EntitySnapshot &msg);
     void ProcessMsg(Msg_S_EntitySpawn &msg);
     void ProcessMsg(Msg_S_TileChunk &msg);
-    void ProcessMsg(Msg_S_TileUpdate &msg);
+    void ProcessMsg(Msg_S_TileDelta &msg);
     void ProcessMsg(Msg_S_TitleShow &msg);
+    void ProcessMsg(Msg_S_WorldSnapshot &msg);
     void ProcessMessages(void);
 
     void Update(void);
@@ -119,8 +119,43 @@ void Anya_Node::CalcCost(void)
 }
 
 Anya_State::Anya_State(Vector2 start, Vector2 target, Anya_SolidQuery solid_query, void *userdata)
-    : start(start), target(target), solid_query(solid_query), userdata(userdata)
-{}
+{
+    Reset(start, target, solid_query, userdata);
+}
+
+void Anya_State::Reset(Vector2 start, Vector2 target, Anya_SolidQuery solid_query, void *userdata)
+{
+    this->start = start;
+    this->target = target;
+    this->solid_query = solid_query;
+    this->userdata = userdata;
+    next_id = 0;
+    target_found = false;
+
+    nodes.clear();
+#if SV_DBG_ANYA_SEARCH_ORDER
+    nodeSearchOrder.clear();
+#endif
+    path.clear();
+    open.clear();
+    gridPath.clear();
+
+    // NOTE(dlb): Bumping the search # empties the root cost table without touching it
+    rootCostCount = 0;
+    search++;
+    if (!search) {
+        for (Anya_RootCost &entry : rootCosts) {
+            entry.search = 0;
+        }
+        search = 1;
+    }
+}
+
+Anya_State &Anya_ThreadState(void)
+{
+    thread_local Anya_State state{};
+    return state;
+}
 
 //inline bool Anya_State::Query(int x, int y)
 //{
@@ -157,6 +192,51 @@ bool Anya_State::AddNodeAndCheckTarget(Anya_Node &node)
     return target_found;
 }
 
+static inline uint32_t Anya_RootHash(Vector2 root)
+{
+    uint32_t hash = std::bit_cast<uint32_t>(root.x) * 0x9E3779B1u ^ std::bit_cast<uint32_t>(root.y) * 0x85EBCA77u;
+    return hash ^ (hash >> 16);
+}
+
+Anya_RootCost &Anya_State::FindRootCost(Vector2 root)
+{
+    // NOTE(dlb): + 0.0f turns -0 into 0, they're the same root
+    root.x += 0.0f;
+    root.y += 0.0f;
+
+    // Keep it at most half full
+    if ((rootCostCount + 1) * 2 > rootCosts.size()) {
+        std::vector<Anya_RootCost> old{};
+        old.swap(rootCosts);
+        rootCosts.resize(MAX(old.size() * 2, 1024));
+        for (const Anya_RootCost &entry : old) {
+            if (entry.search == search) {
+                size_t i = Anya_RootHash(entry.root) & (rootCosts.size() - 1);
+                while (rootCosts[i].search == search) {
+                    i = (i + 1) & (rootCosts.size() - 1);
+                }
+                rootCosts[i] = entry;
+            }
+        }
+    }
+
+    size_t i = Anya_RootHash(root) & (rootCosts.size() - 1);
+    for (;;) {
+        Anya_RootCost &entry = rootCosts[i];
+        if (entry.search != search) {
+            entry.root = root;
+            entry.cost = 0;
+            entry.search = search;
+            rootCostCount++;
+            return entry;
+        }
+        if (entry.root.x == root.x && entry.root.y == root.y) {
+            return entry;
+        }
+        i = (i + 1) & (rootCosts.size() - 1);
+    }
+}
+
 #define CORNER_NW 0b0001
 #define CORNER_NE 0b0010
 #define CORNER_SW 0b0100
@@ -870,8 +950,6 @@ void Anya_Successors(Anya_Node &node)
     Anya_Interval I = node.interval;
     Vector2 r = node.root;
 
-    std::vector<Anya_Node> successors{};
-
     if (node.IsFlat()) {
         const Vector2 p0{ I.x_min, I.y };
         const Vector2 p1{ I.x_max, I.y };
@@ -961,49 +1039,34 @@ bool Anya_ShouldPrune(Anya_Node &node)
 }
 #endif
 
-void Anya(Anya_State &state, float radius)
+void Anya(Anya_State &state, float radius, int maxIters)
 {
-    struct PrioNode {
-        int id{};
-        float cost{};
-        float y{};
-
-        PrioNode(int id, float cost, float y) : id(id), cost(cost), y(y) {}
-
-        bool operator<(const PrioNode &rhs) const
-        {
-            // NOTE: Backwards on purpose, less distance = better heuristic and priority_queue is a max heap -_-
-            return cost > rhs.cost;
-        }
-    };
-    std::priority_queue<PrioNode> open{};
-
     // TODO(dlb): This may still be necessary to prevent cycles:
     // Don't push nodes with equal or higher cost into the open queue.
-#if 1
-    auto Vec2Hash = [](const Vector2 &v) { return hash_combine(v.x, v.y); };
-    auto Vec2Equal = [](const Vector2 &l, const Vector2 &r) { return l.x == r.x && l.y == r.y; };
-    std::unordered_map<Vector2, float, decltype(Vec2Hash), decltype(Vec2Equal)> root_costs{};
-#endif
-
-    const int maxIters = 10000;
     int iters = 0;
-    state.nodes.reserve(maxIters);
+    if (state.nodes.capacity() < maxIters) {
+        state.nodes.reserve(maxIters);
+    }
 
     Anya_Node start = Anya_Node::StartNode(state);
-    open.push({ start.id, start.totalCost, start.interval.y });
+    state.open.push_back({ start.id, start.totalCost, start.interval.y });
+    std::push_heap(state.open.begin(), state.open.end());
     state.nodes.push_back(start);
 
     Anya_Node *target_node = 0;
-    while (iters < maxIters && !target_node && !open.empty()) {
-        const PrioNode &prioNode = open.top();
-        Anya_Node node = state.nodes[prioNode.id];
-        assert(node.interval.y == prioNode.y);
+    while (iters < maxIters && !target_node && !state.open.empty()) {
+        const Anya_OpenNode openNode = state.open.front();
+        std::pop_heap(state.open.begin(), state.open.end());
+        state.open.pop_back();
+
+        Anya_Node node = state.nodes[openNode.id];
+        assert(node.interval.y == openNode.y);
+#if SV_DBG_ANYA_SEARCH_ORDER
         state.nodeSearchOrder.push_back(node);
-        open.pop();
+#endif
 
         if (node.interval.Contains(state.target)) {
-            target_node = &node;
+            target_node = &state.nodes[openNode.id];
             break;
         }
 
@@ -1024,17 +1087,18 @@ void Anya(Anya_State &state, float radius)
                 break;
             }
 
-            const auto &root_cost = root_costs.find(successor.root);
-            if (root_cost == root_costs.end() || root_cost->second == 0 || successor.rootCost <= root_cost->second) {
+            Anya_RootCost &root_cost = state.FindRootCost(successor.root);
+            if (root_cost.cost == 0 || successor.rootCost <= root_cost.cost) {
                 if (!Anya_ShouldPrune(successor)) {
-                    open.push({ successor.id, successor.totalCost, successor.interval.y });
+                    state.open.push_back({ successor.id, successor.totalCost, successor.interval.y });
+                    std::push_heap(state.open.begin(), state.open.end());
 
                     successor.orig_parent = successor.parent;
                     if (Vector2Equals(successor.root, node.root)) {
                         successor.parent = node.parent;
                     }
 
-                    root_costs[successor.root] = successor.rootCost;
+                    root_cost.cost = successor.rootCost;
                 }
             }
         }
@@ -1042,21 +1106,20 @@ void Anya(Anya_State &state, float radius)
     }
 
     if (target_node) {
-        std::stack<Vector2> grid_path{};
-        grid_path.push(state.target);
+        std::vector<Vector2> &grid_path = state.gridPath;
+        grid_path.push_back(state.target);
 
         Anya_Node *node = target_node;
         while (node->parent >= 0) {
-            grid_path.push(node->root);
+            grid_path.push_back(node->root);
             node = &state.nodes[node->parent];
         }
-        grid_path.push(node->root);
+        grid_path.push_back(node->root);
 
         const float nudge = TILE_W / 2; // radius / 1.4142135f;
         Vector2 prevPos{ -1, -1 };
-        while (!grid_path.empty()) {
-            Vector2 gridPos = grid_path.top();
-            grid_path.pop();
+        for (int i = (int)grid_path.size() - 1; i >= 0; i--) {
+            Vector2 gridPos = grid_path[i];
 
             // HACK(dlb): WHY ARE THERE DUPES!?!?!?
             if (Vector2Equals(gridPos, prevPos)) {
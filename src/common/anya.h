@@ -46,6 +46,27 @@ private:
 
 typedef bool (*Anya_SolidQuery)(int x, int y, void *userdata);
 
+struct Anya_OpenNode {
+    int id{};
+    float cost{};
+    float y{};
+
+    bool operator<(const Anya_OpenNode &rhs) const
+    {
+        // NOTE: Backwards on purpose, less distance = better heuristic and std heap functions make a max heap -_-
+        return cost > rhs.cost;
+    }
+};
+
+struct Anya_RootCost {
+    Vector2 root{};
+    float cost{};
+    uint32_t search{};  // Anya_State::search this was set in, older entries are empty
+};
+
+// Search context. Reset() and reuse it (see Anya_ThreadState) rather than making a new one per
+// search, everything is cleared between searches but keeps its capacity, so once it's warmed up
+// searches don't allocate.
 struct Anya_State {
     Vector2 start{};
     Vector2 target{};
@@ -55,8 +76,16 @@ struct Anya_State {
     bool target_found{};
 
     std::vector<Anya_Node> nodes{};
+#if SV_DBG_ANYA_SEARCH_ORDER
     std::vector<Anya_Node> nodeSearchOrder{};
-    std::vector<Vector2> path{};
+#endif
+    std::vector<Vector2> path{};  // world coords (start/target are tile coords), near tile centers
+
+    std::vector<Anya_OpenNode> open{};       // binary heap of node ids to expand
+    std::vector<Anya_RootCost> rootCosts{};  // open addressing, power of 2 size
+    uint32_t rootCostCount{};
+    uint32_t search{};
+    std::vector<Vector2> gridPath{};         // scratch for building path, target first
 
     inline int GetId(void)
     {
@@ -64,7 +93,9 @@ struct Anya_State {
         next_id++;
         return nodes.size();
     }
+    Anya_State(void) = default;
     Anya_State(Vector2 start, Vector2 target, Anya_SolidQuery solid_query, void *userdata);
+    void Reset(Vector2 start, Vector2 target, Anya_SolidQuery solid_query, void *userdata);
 
     inline bool Query_NW(int x, int y);
     inline bool Query_NE(int x, int y);
@@ -72,6 +103,10 @@ struct Anya_State {
     inline bool Query_SE(int x, int y);
 
     bool AddNodeAndCheckTarget(Anya_Node &node);
+
+    Anya_RootCost &FindRootCost(Vector2 root);  // cost = 0 if root hasn't been seen this search
 };
 
-void Anya(Anya_State &state, float radius = 1.0f);
+Anya_State &Anya_ThreadState(void);  // one per thread, Reset() it before each search
+// Gives up (empty path) after expanding maxIters nodes
+void Anya(Anya_State &state, float radius = 1.0f, int maxIters = 10000);
@@ -743,8 +743,10 @@ void dlb_CommonTests(void)
 #include "entity_db.cpp"
 #include "error.cpp"
 #include "file_utils.cpp"
+#include "flow_field.cpp"
 #include "haq.cpp"
 #include "histogram.cpp"
+#include "hpa.cpp"
 #include "lz4.c"
 #include "io.cpp"
 #include "net/net.cpp"
@@ -752,6 +754,7 @@ void dlb_CommonTests(void)
 #include "perf_timer.cpp"
 #include "screen_fx.cpp"
 #include "strings.cpp"
+#include "tile_codec.cpp"
 #include "tilemap.cpp"
 #include "ui/ui.cpp"
 #include "uid.cpp"
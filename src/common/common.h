@@ -16,7 +16,9 @@
 #include <cctype>
 
 #include <array>
+#include <bit>
 #include <bitset>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -129,9 +131,21 @@
 
 #define SV_PORT                              4040 //40000
 #define SV_TICK_DT                           (1.0/30.0)
+#define SV_TICK_MAX_CATCHUP                  3      // max ticks to simulate in one update before dropping the backlog
+#define SV_TICK_POLL_DT                      0.004  // while waiting for the next tick, how often to check for packets
+#define SV_TICK_SLEEP_SLACK                  0.001  // stop sleeping this long before a tick is due and yield instead (sleep is imprecise)
+#ifndef SV_HEADLESS
+#define SV_HEADLESS                          0  // dedicated server build: no window, textures, audio, or editor
+#endif
+#if SV_HEADLESS
+#define SV_RENDER                            0
+#else
 #define SV_RENDER                            1
+#endif
 #define SV_MAX_PLAYERS                       8
-#define SV_MAX_ENTITIES                      256
+#define SV_MAX_ENTITIES                      65536  // per EntityDB, the pool grows a page at a time up to this
+#define SV_ENTITY_POOL_PAGE_SIZE             1024   // # of entity slots the EntityDB pool grows by
+#define SV_ENTITY_GENERATION_BITS            8      // low bits of an entity id are the generation of its slot, see EntityDB
 #define SV_MAX_ENTITY_NAME_LEN               63 // "Goranza The Arch-Nemesis Defiler of Doom" was the longest name I could think of when I wrote this
 #define SV_MAX_ENTITY_SAY_TITLE_LEN          SV_MAX_ENTITY_NAME_LEN
 #define SV_MAX_ENTITY_SAY_MSG_LEN            1023
@@ -141,7 +155,30 @@
 #define SV_MAX_TILE_INTERACT_DIST_IN_TILES   1  // max distance player can be from a tile to interact with it
 #define SV_MAX_ENTITY_INTERACT_DIST          (TILE_W * 2)  // max distance player can be from a tile to interact with it
 #define SV_MAX_TITLE_LEN                     127
+#define SV_SNAPSHOT_HISTORY                  32   // # of recent snapshots remembered per client, for use as delta baselines
+#define SV_SNAPSHOT_MAX_BASELINE_AGE         255  // max # of ticks between a snapshot and the baseline it's delta-encoded against
+#define SV_SNAPSHOT_BUDGET_BYTES             1000 // max size of the entity records in one world snapshot, keeps it to a single unfragmented packet
+#define SV_ENTITY_GRID_CELL_W                (TILE_W * 4)  // size of EntityDB spatial grid cells, in pixels
+#define SV_ENTITY_MAX_EXTENT                 (TILE_W * 2)  // how far an entity's sprite can reach from its position, for padding spatial queries
+#define SV_RELEVANCE_RADIUS                  (TILE_W * 20)  // entities this close to a player (on the same map) are sent to them
+#define SV_RELEVANCE_HYSTERESIS              (TILE_W * 4)   // how much further than that they have to go before they're despawned again
+#define SV_NET_POSITION_RES                  (1.0f / 8.0f)   // position precision on the wire, in pixels (must be a power of 2)
+#define SV_NET_POSITION_MARGIN               (TILE_W * 4)    // how far outside the largest map positions can be sent without clamping
+#define SV_NET_POSITION_Z_MAX                (TILE_W * 8)    // max height (and depth) above the ground that can be sent
+#define SV_NET_VELOCITY_RES                  (1.0f / 16.0f)  // velocity precision on the wire, in pixels/sec (must be a power of 2)
+#define SV_NET_VELOCITY_MAX                  4096            // max speed along any axis that can be sent, in pixels/sec
+#define SV_SNAPSHOT_PRIORITY_DIST            (TILE_W * 16)  // entities this close to a player are prioritized when a snapshot is over budget
 #define SV_COMPRESS_TILE_CHUNK_WITH_LZ4      1
+#define SV_MAX_TILE_CHUNKS_PER_TICK          2  // max # of tile chunks streamed to one client per tick, the rest wait for the next tick
+#define SV_MAX_TILE_DELTA_TILES              256  // chunks with more changed tiles than this in one tick are resent whole instead
+#define SV_PATH_WORKERS                      2      // max # of pathfinding threads (fewer on machines with fewer cores)
+#define SV_PATH_MAX_PENDING                  256    // max # of path requests waiting for a worker
+#define SV_PATH_MAX_REQUESTS_PER_TICK        16     // max # of path requests handed to the workers per tick
+#define SV_PATH_TICK_BUDGET                  0.008  // seconds of pathfinding the workers may do per tick
+#define SV_PATH_HPA_MIN_DIST                 48     // paths longer than this many tiles (along either axis) search the cluster graph first
+#define SV_PATH_CACHE_SIZE                   256    // # of recently found paths to remember (see PathService::cacheHits/Misses)
+#define SV_FLOW_FIELD_RADIUS                 32     // tiles around the goal a chase flow field covers (see Tilemap::FlowTo)
+#define SV_FLOW_FIELD_TTL                    5.0    // seconds a flow field sticks around after it was last used
 
 //#define CL_PORT                 30000
 #define CL_MENU_FADE_IN_DURATION        0.5
@@ -150,7 +187,7 @@
 #define CL_SEND_INPUT_COUNT             64
 #define CL_SEND_INPUT_DT                SV_TICK_DT //(1.0/120.0)
 #define CL_SNAPSHOT_COUNT               2
-#define CL_RENDER_DISTANCE              1
+#define CL_RENDER_DISTANCE              1  // radius, in tile chunks around the player's chunk, that the server streams to the client
 #define CL_CAMERA_LERP                  0
 #define CL_CLIENT_SIDE_PREDICT          1
 #define CL_DIALOG_DURATION_MIN          1.0
@@ -169,6 +206,13 @@
 #define CL_DBG_FORCE_ACCUM     0
 #define CL_DBG_PIXEL_FIXER     0
 
+#define SV_DBG_BENCHMARKS      0  // run the *Benchmark() functions at server startup and print the results
+#if _DEBUG
+#define SV_DBG_ANYA_SEARCH_ORDER 1  // record the order Anya expands nodes in (see Tilemap::DrawIntervals)
+#else
+#define SV_DBG_ANYA_SEARCH_ORDER 0
+#endif
+
 Font dlb_LoadFontFromMemory(const char *fileType, const unsigned char *fileData, int dataSize, int fontSize, int *fontChars, int glyphCount, int type);
 Font dlb_LoadFontEx(const char *fileName, int fontSize, int *fontChars, int glyphCount, int type);
 Vector2 dlb_MeasureTextEx(Font font, const char *text, size_t textLen, Vector2 *cursor = 0);
@@ -174,6 +174,7 @@ Err Init(void)
 
     rnStringCatalog.Init();
 
+#if !SV_HEADLESS
     // Load SDF required shader (we use default vertex shader)
     shdSdfText = LoadShader(0, "resources/shader/sdf.fs");
 
@@ -205,6 +206,7 @@ Err Init(void)
     fntBig = dlb_LoadFontEx(fontName, 46, 0, 0, FONT_DEFAULT);
     ERR_RETURN_EX(fntBig.baseSize, RN_RAYLIB_ERROR);
     //SetTextureFilter(fntBig.texture, TEXTURE_FILTER_BILINEAR);    // Required for SDF font
+#endif
 
     //GenPlaceholderTexture();
 
@@ -223,11 +225,15 @@ Err Init(void)
     }
 #endif
 
+    // NOTE(dlb): Headless server only needs the pack data, not the textures/music/sounds
+    const bool loadMedia = !SV_HEADLESS;
+
     ERR_RETURN(LoadPack(pack_assets, PACK_TYPE_BINARY));
-    ERR_RETURN(LoadResources(pack_assets));
+    ERR_RETURN(LoadResources(pack_assets, loadMedia));
+    InvalidateAutoTiles();
 #if SV_SERVER
     ERR_RETURN(LoadPack(pack_maps, PACK_TYPE_BINARY));
-    ERR_RETURN(LoadResources(pack_maps));
+    ERR_RETURN(LoadResources(pack_maps, loadMedia));
 #endif
 
 #if 0
@@ -247,12 +253,14 @@ Err Init(void)
 }
 void Free(void)
 {
+#if !SV_HEADLESS
     UnloadShader(shdSdfText);
     UnloadShader(shdPixelFixer);
     UnloadFont(fntTiny);
     UnloadFont(fntSmall);
     UnloadFont(fntMedium);
     UnloadFont(fntBig);
+#endif
 
     // NOTE(dlb): ~Material is crashing for unknown reason. double free or trying to free string constant??
     // NOTE(dlb): delete pack takes *forever*. Who cares. Let OS figure it out.
@@ -283,6 +291,7 @@ const SfxVariant &PickSoundVariant(const SfxFile &sfx_file)
 void PlaySound(const std::string &id, float pitchVariance)
 {
     const SfxFile &sfx_file = pack_assets.FindByName<SfxFile>(id);
+    if (sfx_file.variants.empty()) return;  // sounds not loaded (e.g. headless server)
     const SfxVariant &sfx_variant = PickSoundVariant(sfx_file);
     assert(sfx_variant.instances.size() == sfx_file.max_instances);
 
@@ -299,6 +308,7 @@ void PlaySound(const std::string &id, float pitchVariance)
 bool IsSoundPlaying(const std::string &id)
 {
     const SfxFile &sfx_file = pack_assets.FindByName<SfxFile>(id);
+    if (sfx_file.variants.empty()) return false;  // sounds not loaded (e.g. headless server)
     const SfxVariant &sfx_variant = PickSoundVariant(sfx_file);
     assert(sfx_variant.instances.size() == sfx_file.max_instances);
 
@@ -312,6 +322,7 @@ bool IsSoundPlaying(const std::string &id)
 void StopSound(const std::string &id)
 {
     const SfxFile &sfx_file = pack_assets.FindByName<SfxFile>(id);
+    if (sfx_file.variants.empty()) return;  // sounds not loaded (e.g. headless server)
     const SfxVariant &sfx_variant = PickSoundVariant(sfx_file);
     assert(sfx_variant.instances.size() == sfx_file.max_instances);
 
@@ -416,15 +427,65 @@ TileDef &GetTileDef(uint16_t tile_id)
     }
     return pack_assets.tile_defs[0];
 }
-TileDef *FindTileDefByMask(uint8_t auto_tile_group, int mask)
+// [auto_tile_group][neighbor mask] -> tile id, with the partial matches already resolved (0 = no match)
+static std::vector<std::array<uint16_t, 256>> autoTileLut{};
+static bool autoTileLutDirty = true;
+
+static void BuildAutoTileLut(void)
 {
-    // TODO(perf): Hash table (also, match materials somehow?)
-    for (TileDef &tile_def : pack_assets.tile_defs) {
-        if (tile_def.id && tile_def.auto_tile_group == auto_tile_group && tile_def.auto_tile_mask == mask) {
-            return &tile_def;
+    enum AutoMask {
+        NW = 0b10000000, N = 0b01000000, NE = 0b00100000, W = 0b00010000,
+        E  = 0b00001000, SW = 0b00000100, S = 0b00000010, SE = 0b00000001
+    };
+
+    // Exact matches, first tile def wins
+    std::vector<std::array<uint16_t, 256>> exact{};
+    for (const TileDef &tile_def : pack_assets.tile_defs) {
+        if (!tile_def.id || !tile_def.auto_tile_group) {
+            continue;
+        }
+        if (tile_def.auto_tile_group >= exact.size()) {
+            exact.resize((size_t)tile_def.auto_tile_group + 1);
+        }
+        uint16_t &tile_id = exact[tile_def.auto_tile_group][tile_def.auto_tile_mask];
+        if (!tile_id) {
+            tile_id = tile_def.id;
+        }
+    }
+
+    autoTileLut.assign(exact.size(), {});
+    for (size_t group = 1; group < exact.size(); group++) {
+        for (int mask = 0; mask < 256; mask++) {
+            // Partial match ignores corners that aren't fully connected (via both adjacent edges),
+            // then all corners
+            int partial_mask = mask;
+            if ((mask & (N | W)) != (N | W)) partial_mask &= ~NW;
+            if ((mask & (N | E)) != (N | E)) partial_mask &= ~NE;
+            if ((mask & (S | W)) != (S | W)) partial_mask &= ~SW;
+            if ((mask & (S | E)) != (S | E)) partial_mask &= ~SE;
+            const int edge_mask = mask & (N | W | E | S);
+
+            uint16_t tile_id = exact[group][mask];
+            if (!tile_id) tile_id = exact[group][partial_mask];
+            if (!tile_id) tile_id = exact[group][edge_mask];
+            autoTileLut[group][mask] = tile_id;
         }
     }
-    return 0;
+    autoTileLutDirty = false;
+}
+uint16_t FindAutoTile(uint8_t auto_tile_group, uint8_t mask)
+{
+    if (autoTileLutDirty) {
+        BuildAutoTileLut();
+    }
+    if (auto_tile_group >= autoTileLut.size()) {
+        return 0;
+    }
+    return autoTileLut[auto_tile_group][mask];
+}
+void InvalidateAutoTiles(void)
+{
+    autoTileLutDirty = true;
 }
 const GfxFrame &GetTileGfxFrame(uint16_t tile_id)
 {
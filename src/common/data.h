@@ -298,7 +298,10 @@ void DrawSprite(const Entity &entity, DrawCmdQueue *sortedDraws, bool highlight
 void UpdateTileDefAnimations(double dt);
 
 TileDef &GetTileDef(uint16_t tile_id);
-TileDef *FindTileDefByMask(uint8_t auto_tile_group, int mask);
+// Tile id to use for a tile in auto_tile_group with the given neighbors in the same group, 0 if
+// the group has no tile for it
+uint16_t FindAutoTile(uint8_t auto_tile_group, uint8_t mask);
+void InvalidateAutoTiles(void);  // call when tile def auto-tile groups/masks change
 const GfxFrame &GetTileGfxFrame(uint16_t tile_id);
 Rectangle TileDefRect(uint16_t tile_id);
 Color TileDefAvgColor(uint16_t tile_id);
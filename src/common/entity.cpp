@@ -19,23 +19,24 @@ GhostSnapshot::GhostSnapshot(Msg_S_EntitySpawn &msg)
     velocity = msg.velocity;
 }
 
-GhostSnapshot::GhostSnapshot(Msg_S_EntitySnapshot &msg)
+GhostSnapshot::GhostSnapshot(Msg_S_WorldSnapshot &msg, const EntityNetState &state)
 {
+    // NOTE(dlb): state must already have the delta applied, i.e. all fields present
     server_time              = msg.server_time;
     last_processed_input_cmd = msg.last_processed_input_cmd;
 
     // Entity
-    map_id   = msg.map_id;
-    position = msg.position;
-    on_warp_cooldown = msg.on_warp_cooldown;
+    map_id   = state.map_id;
+    position = state.position;
+    on_warp_cooldown = state.on_warp_cooldown;
 
     // Life
-    hp_max   = msg.hp_max;
-    hp       = msg.hp;
+    hp_max   = state.hp_max;
+    hp       = state.hp;
 
     // Physics
     //speed    = msg.speed;
-    velocity = msg.velocity;
+    velocity = state.velocity;
 }
 
 const char *EntityTypeStr(Entity::Type type)
@@ -107,8 +108,8 @@ Vector2 Entity::TopCenter(void) const
 void Entity::ClearDialog(void)
 {
     dialog_spawned_at = 0;
-    dialog_title = {};
-    dialog_message = {};
+    cold->dialog_title = {};
+    cold->dialog_message = {};
 }
 
 bool Entity::Attack(double now)
@@ -1,7 +1,8 @@
 #pragma once
 
 struct Msg_S_EntitySpawn;
-struct Msg_S_EntitySnapshot;
+struct Msg_S_WorldSnapshot;
+struct EntityNetState;
 
 enum Direction : uint8_t {
     DIR_N,
@@ -37,12 +38,37 @@ struct GhostSnapshot {
 
     GhostSnapshot(void) {}
     GhostSnapshot(Msg_S_EntitySpawn &msg);
-    GhostSnapshot(Msg_S_EntitySnapshot &msg);
+    GhostSnapshot(Msg_S_WorldSnapshot &msg, const EntityNetState &state);
 };
 typedef RingBuffer<GhostSnapshot, CL_SNAPSHOT_COUNT> AspectGhost;
 
-// std::string -> StringId
-// 672 bytes -> 296 bytes
+// Strings and other data that's rarely touched, kept in a side table (see EntityDB::cold) so
+// that Entity stays small and the tick loop doesn't drag it through the cache.
+struct EntityCold {
+    std::string name {};
+
+    //// Audio ////
+    std::string ambient_fx           {};  // some sound they play occasionally
+    double      ambient_fx_delay_min {};
+    double      ambient_fx_delay_max {};
+
+    //// Dialog ////
+    // server-side
+    std::string dialog_root_key {};  // Root node of dialog tree
+
+    // client-side
+    std::string dialog_title    {};  // name of NPC, submenu, etc.
+    std::string dialog_message  {};  // what they're saying
+
+    //// Inventory ////
+    std::string holdingItem {};
+
+    //// Warp ////
+    std::string warp_template_tileset {};  // wang tileset to use for procgen
+};
+
+// std::string -> EntityCold
+// 520 bytes -> 280 bytes
 struct Entity {
     static const DataType dtype = DAT_TYP_ENTITY;
 
@@ -63,51 +89,48 @@ struct Entity {
         SPC_COUNT
     };
 
+    // NOTE(dlb): Everything EntityTick and the collision passes touch every tick lives up here,
+    // in the first cache line. Don't put anything in front of it.
+
     //// Entity ////
     uint32_t    id            {};
     Type        type          {};
     Species     spec          {};
-    std::string name          {};
-    uint32_t    caused_by     {};  // who spawned the projectile?
-    double      spawned_at    {};
-    double      despawned_at  {};
+
+    //// Collision ////
+    bool  colliding        {};  // not sync'd, local flag for debugging colliders
+    bool  on_warp          {};  // currently colliding with a warp
+    bool  on_warp_cooldown {};  // true when we've already warped but have not stepped off all warps yet (to prevent ping-ponging)
+    float radius           {};  // collision
 
     uint32_t    map_id        {};
     Vector3     position      {};
-    AspectGhost *ghost        {};
 
-    //// Audio ////
-    std::string ambient_fx           {};  // some sound they play occasionally
-    double      ambient_fx_delay_min {};
-    double      ambient_fx_delay_max {};
+    //// Physics ////
+    Vector3 velocity      {};
+    Vector3 force_accum   {};
+    float   drag          {};
+    float   speed         {};
+    double  last_moved_at {};
 
-    //// Collision ////
-    float radius      {};  // collision
-    bool  colliding   {};  // not sync'd, local flag for debugging colliders
-    bool  on_warp     {};  // currently colliding with a warp
-    struct {
-        uint32_t x {};
-        uint32_t y {};
-    } on_warp_coord;  // coord of first detected warp we're standing on
-    bool  on_warp_cooldown {};  // true when we've already warped but have not stepped off all warps yet (to prevent ping-ponging)
+    //// Lifetime ////
+    double   despawned_at {};
+    double   spawned_at   {};
+    uint32_t caused_by    {};  // who spawned the projectile?
+
+    //// Aspects ////
+    EntityCold  *cold  {};  // see EntityDB::cold
+    AspectGhost *ghost {};
 
     //// Combat ////
     double last_attacked_at {};
     double attack_cooldown  {};
 
     //// Dialog ////
-    // server-side
-    std::string dialog_root_key   {};  // Root node of dialog tree
-
     // TODO: replace with a pointer to a pool of active dialogs (or just 1??)
     // client-side
     double      dialog_spawned_at {};  // time when dialog was spawned
     uint32_t    dialog_id         {};  // which dialog is active
-    std::string dialog_title      {};  // name of NPC, submenu, etc.
-    std::string dialog_message    {};  // what they're saying
-
-    //// Inventory ////
-    std::string holdingItem {};
 
     //// Life ////
     float hp_max    {};
@@ -123,13 +146,7 @@ struct Entity {
     Vector3 path_rand_direction  {};  // move this direction (if possible)
     double  path_rand_duration   {};  // for this long
     double  path_rand_started_at {};  // when we started moving this way
-
-    //// Physics ////
-    float   drag          {};
-    float   speed         {};
-    Vector3 force_accum   {};
-    Vector3 velocity      {};
-    double  last_moved_at {};
+    bool    path_rand_flow       {};  // chasing the player down the map's flow field, direction is re-aimed every tick
 
     //// Sprite ////
     uint32_t     sprite_id  {};  // sprite resource
@@ -137,14 +154,18 @@ struct Entity {
     GfxAnimState anim_state {};  // keep track of the animation as it plays
 
     //// Warp ////
+    struct {
+        uint32_t x {};
+        uint32_t y {};
+    } on_warp_coord;  // coord of first detected warp we're standing on
+
     Rectangle warp_collider {};
     Vector3   warp_dest_pos {};
 
     // You either need this
     uint32_t    warp_dest_map         {};  // regular map to warp to
-    // Or both of these
+    // Or this and cold->warp_template_tileset
     uint32_t    warp_template_map     {};  // template map to make a copy of for procgen
-    std::string warp_template_tileset {};  // wang tileset to use for procgen
 
     Vector2 Position2D(void);
     const GfxFrame &GetSpriteFrame() const;
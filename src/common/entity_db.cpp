@@ -1,17 +1,30 @@
 #include "entity_db.h"
 #include <cassert>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define ENTITY_TICK_SSE 1
+    #include <xmmintrin.h>
+#else
+    #define ENTITY_TICK_SSE 0
+#endif
+
 // TODO: Move this into GameClient prolly, eh?
 EntityDB *entityDb{};
 
+static_assert(SV_ENTITY_GENERATION_BITS <= 8, "EntityDB::generations only has 8 bits per slot");
+static_assert(SV_MAX_ENTITIES <= (1ull << (32 - SV_ENTITY_GENERATION_BITS)), "entity ids don't have enough index bits for SV_MAX_ENTITIES");
+
 Entity *EntityDB::FindEntity(uint32_t entity_id, bool evenIfDespawned)
 {
-    const auto &iter = entities_by_id.find(entity_id);
-    if (iter == entities_by_id.end()) {
+    const uint32_t index = EntityIdIndex(entity_id);
+    if (!index || !entities.Has(index)) {
         return 0;
     }
 
-    Entity &entity = entities[iter->second];
+    Entity &entity = entities[index];
+    if (entity.id != entity_id) {
+        return 0;
+    }
     assert(entity.type);
     if (entity.despawned_at && !evenIfDespawned) {
         return 0;
@@ -27,35 +40,69 @@ Entity *EntityDB::FindEntity(uint32_t entity_id, Entity::Type type, bool evenIfD
     }
     return entity;
 }
+Entity *EntityDB::SpawnEntity(Entity::Type type, double now)
+{
+    assert(type);
+
+    uint32_t index = 0;
+    if (free_slots.size()) {
+        index = free_slots.front();
+        free_slots.pop();
+    } else if (next_slot < SV_MAX_ENTITIES) {
+        index = next_slot++;
+        entities.Grow(index);
+        cold.Grow(index);
+        ghosts.Grow(index);
+        spatial.Grow(index);
+        generations.Grow(index);
+    } else {
+        printf("[entity_db] Failed to spawn entity of type %s. Max entities.\n", EntityTypeStr(type));
+        return 0;
+    }
+
+    const uint32_t entity_id = EntityIdMake(index, generations[index]);
+    return SpawnEntityAt(index, entity_id, type, now);
+}
 Entity *EntityDB::SpawnEntity(uint32_t entity_id, Entity::Type type, double now)
 {
     assert(entity_id);
     assert(type);
 
-    Entity *entity = FindEntity(entity_id);
-    if (entity) {
-        printf("[entity_db] Failed to spawn entity id %u of type %s. An entity with that id already exists.\n", entity_id, EntityTypeStr(type));
-        assert(!"entity already exists.. huh?");
+    const uint32_t index = EntityIdIndex(entity_id);
+    if (!index || index >= SV_MAX_ENTITIES) {
+        printf("[entity_db] Failed to spawn entity id %u of type %s. Id out of range.\n", entity_id, EntityTypeStr(type));
         return 0;
     }
 
-    if (entities_by_id.size() < SV_MAX_ENTITIES) {
-        for (int i = 1; i < entities.size(); i++) {
-            if (!entities[i].id) {
-                entity = &entities[i];
-                entity->id = entity_id;
-                entity->type = type;
-                entity->spawned_at = now;
-                entity->ghost = &ghosts[i];
-                entities_by_id[entity_id] = i;
-                break;
-            }
-        }
-    }
+    entities.Grow(index);
+    cold.Grow(index);
+    ghosts.Grow(index);
+    spatial.Grow(index);
+    generations.Grow(index);
 
-    if (!entity) {
-        printf("[entity_db] Failed to spawn entity id %u of type %s. Max entities.\n", entity_id, EntityTypeStr(type));
+    Entity &existing = entities[index];
+    if (existing.id == entity_id) {
+        printf("[entity_db] Failed to spawn entity id %u of type %s. An entity with that id already exists.\n", entity_id, EntityTypeStr(type));
+        assert(!"entity already exists.. huh?");
+        return 0;
+    } else if (existing.id) {
+        // NOTE(dlb): The server only reuses a slot after it has destroyed the previous entity,
+        // so we shouldn't see this, but if we do the old one is definitely gone.
+        printf("[entity_db] Entity id %u is replacing stale entity id %u.\n", entity_id, existing.id);
+        DestroyEntity(existing.id);
     }
+
+    return SpawnEntityAt(index, entity_id, type, now);
+}
+Entity *EntityDB::SpawnEntityAt(uint32_t index, uint32_t entity_id, Entity::Type type, double now)
+{
+    Entity *entity = &entities[index];
+    assert(!entity->id);
+    entity->id = entity_id;
+    entity->type = type;
+    entity->spawned_at = now;
+    entity->cold = &cold[index];
+    entity->ghost = &ghosts[index];
     return entity;
 }
 bool EntityDB::DespawnEntity(uint32_t entity_id, double now)
@@ -78,11 +125,16 @@ void EntityDB::DestroyEntity(uint32_t entity_id)
         assert(entity->id);   // wtf happened man
         assert(entity->type); // wtf happened man
 
+        const uint32_t index = EntityIdIndex(entity_id);
+        RemoveSpatial(index);
+
         // Clear aspects
+        *entity->cold = {};
         *entity->ghost = {};
         *entity = {};
 
-        entities_by_id.erase(entity_id);
+        generations[index] = (EntityIdGeneration(entity_id) + 1) & ((1u << SV_ENTITY_GENERATION_BITS) - 1);
+        free_slots.push(index);
     } else {
         assert(0);
         printf("error: entity_id %u out of range\n", entity_id);
@@ -129,7 +181,7 @@ void EntityDB::EntityTick(Entity &entity, double dt, double now)
     // Lerping: current = Mathf.Lerp(current, target, 1.0f - Mathf.Exp(-Sharpness * Time.deltaTime));
     // Damping: current *= Mathf.Exp(-Sharpness * Time.deltaTime);
 
-    vel = Vector3Scale(vel, exp2f(-10.0f * (entity.drag) * dt));
+    vel = Vector3Scale(vel, EntityDamping(entity.drag, dt));
     if (Vector3LengthSqr(vel) < 0.1f * 0.1f) {
         vel = Vector3Zero();
     }
@@ -141,6 +193,232 @@ void EntityDB::EntityTick(Entity &entity, double dt, double now)
         entity.velocity = vel;
         entity.position = pos;
         entity.last_moved_at = now;
+        UpdateSpatial(entity);
+    }
+}
+float EntityDB::EntityDamping(float drag, double dt)
+{
+    return exp2f(-10.0f * drag * dt);
+}
+void EntityDB::EntityTickBatch(Entity *const *batch, size_t count, double dt, double now)
+{
+    // NOTE(dlb): This has to give exactly the same answer as EntityTick, the client predicts its
+    // own player with EntityTick and the server moves it with this. Everything below is the same
+    // float ops in the same order (no FMA, no rsqrt, etc.), the only thing that's shared between
+    // entities is the damping factor, and that's only reused when the drag is the same. Don't
+    // build with /fp:fast or -ffast-math, the compiler is allowed to reorder the scalar path.
+    float lastDrag = NAN;
+    float lastDamping = 0;
+
+    size_t i = 0;
+#if ENTITY_TICK_SSE
+    const __m128 dtv = _mm_set1_ps((float)dt);
+    const __m128 minSpeedSq = _mm_set1_ps(0.1f * 0.1f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(EPSILON);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        Entity &e0 = *batch[i];
+        Entity &e1 = *batch[i + 1];
+        Entity &e2 = *batch[i + 2];
+        Entity &e3 = *batch[i + 3];
+
+        float damping[4]{};
+        for (int lane = 0; lane < 4; lane++) {
+            const float drag = batch[i + lane]->drag;
+            if (drag != lastDrag) {
+                lastDrag = drag;
+                lastDamping = EntityDamping(drag, dt);
+            }
+            damping[lane] = lastDamping;
+        }
+
+        // Gather into SoA lanes
+        __m128 vx = _mm_setr_ps(e0.velocity.x, e1.velocity.x, e2.velocity.x, e3.velocity.x);
+        __m128 vy = _mm_setr_ps(e0.velocity.y, e1.velocity.y, e2.velocity.y, e3.velocity.y);
+        __m128 vz = _mm_setr_ps(e0.velocity.z, e1.velocity.z, e2.velocity.z, e3.velocity.z);
+        const __m128 fx = _mm_setr_ps(e0.force_accum.x, e1.force_accum.x, e2.force_accum.x, e3.force_accum.x);
+        const __m128 fy = _mm_setr_ps(e0.force_accum.y, e1.force_accum.y, e2.force_accum.y, e3.force_accum.y);
+        const __m128 fz = _mm_setr_ps(e0.force_accum.z, e1.force_accum.z, e2.force_accum.z, e3.force_accum.z);
+        const __m128 ox = _mm_setr_ps(e0.position.x, e1.position.x, e2.position.x, e3.position.x);
+        const __m128 oy = _mm_setr_ps(e0.position.y, e1.position.y, e2.position.y, e3.position.y);
+        const __m128 oz = _mm_setr_ps(e0.position.z, e1.position.z, e2.position.z, e3.position.z);
+        const __m128 damp = _mm_loadu_ps(damping);
+
+        // Vector3LengthSqr(entity.velocity) != 0
+        const __m128 oldSpeedSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        const __m128 wasMoving = _mm_cmpneq_ps(oldSpeedSq, zero);
+
+        // vel += force * dt
+        vx = _mm_add_ps(vx, _mm_mul_ps(fx, dtv));
+        vy = _mm_add_ps(vy, _mm_mul_ps(fy, dtv));
+        vz = _mm_add_ps(vz, _mm_mul_ps(fz, dtv));
+
+        // vel *= damping, snap to zero when slow enough
+        vx = _mm_mul_ps(vx, damp);
+        vy = _mm_mul_ps(vy, damp);
+        vz = _mm_mul_ps(vz, damp);
+        const __m128 speedSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        const __m128 stopped = _mm_cmplt_ps(speedSq, minSpeedSq);
+        vx = _mm_andnot_ps(stopped, vx);
+        vy = _mm_andnot_ps(stopped, vy);
+        vz = _mm_andnot_ps(stopped, vz);
+
+        // pos += vel * dt
+        const __m128 px = _mm_add_ps(ox, _mm_mul_ps(vx, dtv));
+        const __m128 py = _mm_add_ps(oy, _mm_mul_ps(vy, dtv));
+        const __m128 pz = _mm_add_ps(oz, _mm_mul_ps(vz, dtv));
+
+        // !Vector3Equals(pos, entity.position), i.e. any |p - o| > EPSILON * max(1, |p|, |o|).
+        // NaNs fail the compare either way, same as the scalar version.
+        #define ENTITY_TICK_SSE_EQUALS(p, o) _mm_cmple_ps( \
+            _mm_andnot_ps(signBit, _mm_sub_ps(p, o)), \
+            _mm_mul_ps(epsilon, _mm_max_ps(one, _mm_max_ps(_mm_andnot_ps(signBit, p), _mm_andnot_ps(signBit, o)))))
+        const __m128 samePos = _mm_and_ps(_mm_and_ps(
+            ENTITY_TICK_SSE_EQUALS(px, ox),
+            ENTITY_TICK_SSE_EQUALS(py, oy)),
+            ENTITY_TICK_SSE_EQUALS(pz, oz));
+        #undef ENTITY_TICK_SSE_EQUALS
+        const int moved = (~_mm_movemask_ps(samePos) & 0xF) | _mm_movemask_ps(wasMoving);
+
+        // Scatter
+        float out[6][4]{};
+        _mm_storeu_ps(out[0], vx);
+        _mm_storeu_ps(out[1], vy);
+        _mm_storeu_ps(out[2], vz);
+        _mm_storeu_ps(out[3], px);
+        _mm_storeu_ps(out[4], py);
+        _mm_storeu_ps(out[5], pz);
+        for (int lane = 0; lane < 4; lane++) {
+            Entity &entity = *batch[i + lane];
+            entity.force_accum = {};
+            if (moved & (1 << lane)) {
+                entity.velocity = { out[0][lane], out[1][lane], out[2][lane] };
+                entity.position = { out[3][lane], out[4][lane], out[5][lane] };
+                entity.last_moved_at = now;
+                UpdateSpatial(entity);
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        EntityTick(*batch[i], dt, now);
+    }
+}
+
+static inline int32_t SpatialCellCoord(float world)
+{
+    return (int32_t)floorf(world / SV_ENTITY_GRID_CELL_W);
+}
+static inline uint64_t SpatialCellKey(int32_t cell_x, int32_t cell_y)
+{
+    return ((uint64_t)(uint32_t)cell_x << 32) | (uint32_t)cell_y;
+}
+uint32_t EntityDB::SlotIndex(const Entity &entity)
+{
+    // Copies (e.g. the client's prediction ghost) get ticked too, they just aren't in the pool
+    const uint32_t index = EntityIdIndex(entity.id);
+    if (!index || !entities.Has(index) || &entities[index] != &entity) {
+        return 0;
+    }
+    return index;
+}
+void EntityDB::UpdateSpatial(Entity &entity)
+{
+    const uint32_t index = SlotIndex(entity);
+    if (!index) {
+        return;
+    }
+    SpatialRecord &record = spatial[index];
+
+    const int32_t cell_x = SpatialCellCoord(entity.position.x);
+    const int32_t cell_y = SpatialCellCoord(entity.position.y);
+    if (record.in_grid && record.map_id == entity.map_id && record.cell_x == cell_x && record.cell_y == cell_y) {
+        return;
+    }
+
+    RemoveSpatial(index);
+
+    record.in_grid = true;
+    record.map_id  = entity.map_id;
+    record.cell_x  = cell_x;
+    record.cell_y  = cell_y;
+    grids[entity.map_id].cells[SpatialCellKey(cell_x, cell_y)].push_back(index);
+}
+void EntityDB::RemoveSpatial(uint32_t index)
+{
+    SpatialRecord &record = spatial[index];
+    if (!record.in_grid) {
+        return;
+    }
+
+    SpatialGrid &grid = grids[record.map_id];
+    const auto &cell = grid.cells.find(SpatialCellKey(record.cell_x, record.cell_y));
+    assert(cell != grid.cells.end());
+    if (cell != grid.cells.end()) {
+        std::vector<uint32_t> &indices = cell->second;
+        for (size_t i = 0; i < indices.size(); i++) {
+            if (indices[i] == index) {
+                indices[i] = indices.back();
+                indices.pop_back();
+                break;
+            }
+        }
+        // NOTE(dlb): Empty cells are left in the map, entities tend to wander back into them
+    }
+    record = {};
+}
+void EntityDB::QueryRect(uint16_t map_id, Rectangle rect, std::vector<Entity *> &results)
+{
+    results.clear();
+
+    const auto &grid = grids.find(map_id);
+    if (grid == grids.end()) {
+        return;
+    }
+
+    const int32_t min_x = SpatialCellCoord(rect.x);
+    const int32_t min_y = SpatialCellCoord(rect.y);
+    const int32_t max_x = SpatialCellCoord(rect.x + rect.width);
+    const int32_t max_y = SpatialCellCoord(rect.y + rect.height);
+
+    for (int32_t cell_y = min_y; cell_y <= max_y; cell_y++) {
+        for (int32_t cell_x = min_x; cell_x <= max_x; cell_x++) {
+            const auto &cell = grid->second.cells.find(SpatialCellKey(cell_x, cell_y));
+            if (cell == grid->second.cells.end()) {
+                continue;
+            }
+            for (uint32_t index : cell->second) {
+                Entity &entity = entities[index];
+                if (entity.despawned_at) {
+                    continue;
+                }
+                if (entity.position.x >= rect.x && entity.position.x <= rect.x + rect.width &&
+                    entity.position.y >= rect.y && entity.position.y <= rect.y + rect.height)
+                {
+                    results.push_back(&entity);
+                }
+            }
+        }
+    }
+}
+void EntityDB::QueryRadius(uint16_t map_id, Vector2 center, float radius, std::vector<Entity *> &results)
+{
+    const Rectangle bounds{ center.x - radius, center.y - radius, radius * 2, radius * 2 };
+    QueryRect(map_id, bounds, results);
+
+    const float radiusSq = radius * radius;
+    for (size_t i = 0; i < results.size();) {
+        const Vector2 pos{ results[i]->position.x, results[i]->position.y };
+        if (Vector2DistanceSqr(pos, center) > radiusSq) {
+            results[i] = results.back();
+            results.pop_back();
+        } else {
+            i++;
+        }
     }
 }
 
@@ -159,4 +437,159 @@ void EntityDB::DrawEntity(Entity &entity, DrawCmdQueue &sortedDraws, bool highli
 {
     const Rectangle rect = entity.GetSpriteRect();
     DrawSprite(entity, &sortedDraws, highlight);
-}
\ No newline at end of file
+}
+
+void EntityDBTests(void)
+{
+    // EntityTickBatch matches EntityTick bit for bit (client prediction depends on it)
+    {
+        const int entityCount = 103;  // not a multiple of the lane count on purpose
+        const int tickCount = 200;
+
+        EntityDB *db = new EntityDB;
+        std::vector<Entity> scalar(entityCount);
+        for (int i = 0; i < entityCount; i++) {
+            Entity &entity = scalar[i];
+            entity.position = { (float)(i * 37 % 1000) + 0.3f * i, (float)(i * 91 % 1000) - 0.7f * i, (i % 5) ? 0.0f : 12.5f };
+            entity.velocity = { (float)(i % 17) - 8.0f, (float)(i % 13) * 3.1f, 0 };
+            entity.drag = (i % 3) ? 8.0f : 0.5f + 0.25f * (i % 7);
+            entity.speed = 300 + (i % 300);
+        }
+        std::vector<Entity> batched = scalar;
+        std::vector<Entity *> batch{};
+        for (Entity &entity : batched) {
+            batch.push_back(&entity);
+        }
+
+        for (int tick = 0; tick < tickCount; tick++) {
+            const double now = tick * SV_TICK_DT;
+            for (int i = 0; i < entityCount; i++) {
+                // Push some, leave some alone so they slow down and snap to a stop
+                if ((i + tick / 20) % 4) {
+                    const float angle = (float)((i * 7 + tick) % 360) * DEG2RAD;
+                    const Vector3 force{ cosf(angle) * scalar[i].speed, sinf(angle) * scalar[i].speed, (i % 11) ? 0.0f : 0.01f };
+                    scalar[i].ApplyForce(force);
+                    batched[i].ApplyForce(force);
+                }
+            }
+            for (Entity &entity : scalar) {
+                db->EntityTick(entity, SV_TICK_DT, now);
+            }
+            db->EntityTickBatch(batch.data(), batch.size(), SV_TICK_DT, now);
+
+            for (int i = 0; i < entityCount; i++) {
+                assert(!memcmp(&scalar[i].position, &batched[i].position, sizeof(Vector3)));
+                assert(!memcmp(&scalar[i].velocity, &batched[i].velocity, sizeof(Vector3)));
+                assert(!memcmp(&scalar[i].force_accum, &batched[i].force_accum, sizeof(Vector3)));
+                assert(scalar[i].last_moved_at == batched[i].last_moved_at);
+            }
+        }
+
+        delete db;
+    }
+}
+void EntityDBBenchmark(void)
+{
+    const int entityCount = 16384;
+
+    // Physics integration, walking the pool the same way GameServer::Tick does. Once calling
+    // EntityTick on each entity, once gathering them up and calling EntityTickBatch.
+    for (int batched = 0; batched < 2; batched++) {
+        const int tickCount = 100;
+
+        EntityDB *db = new EntityDB;
+        for (int i = 0; i < entityCount; i++) {
+            Entity *entity = db->SpawnEntity(Entity::TYP_NPC, 0);
+            entity->map_id = 1;
+            entity->position = { (float)(i % 128) * TILE_W, (float)(i / 128) * TILE_W, 0 };
+            entity->radius = 10;
+            entity->speed = 300 + (i % 300);
+            entity->drag = 8.0f;
+            db->UpdateSpatial(*entity);
+        }
+
+        Vector3 directions[64]{};
+        for (int i = 0; i < ARRAY_SIZE(directions); i++) {
+            const float angle = (float)i / ARRAY_SIZE(directions) * 2 * PI;
+            directions[i] = { cosf(angle), sinf(angle), 0 };
+        }
+
+        std::vector<Entity *> batch{};
+        const double startedAt = yojimbo_time();
+        for (int tick = 0; tick < tickCount; tick++) {
+            const double now = tick * SV_TICK_DT;
+            int i = 0;
+            batch.clear();
+            for (Entity &entity : db->entities) {
+                if (!entity.type) {
+                    continue;
+                }
+                // Every 8th entity stands still, like most NPCs do most of the time
+                if (i % 8) {
+                    const Vector3 &dir = directions[(i + tick) % ARRAY_SIZE(directions)];
+                    entity.ApplyForce(Vector3Scale(dir, entity.speed));
+                }
+                if (batched) {
+                    batch.push_back(&entity);
+                } else {
+                    db->EntityTick(entity, SV_TICK_DT, now);
+                }
+                i++;
+            }
+            if (batched) {
+                db->EntityTickBatch(batch.data(), batch.size(), SV_TICK_DT, now);
+            }
+        }
+        const double elapsed = yojimbo_time() - startedAt;
+
+        printf("[entity_db] %s: %d entities x %d ticks in %.2f ms (%.2f ns/entity, sizeof(Entity) = %zu)\n",
+            batched ? "EntityTickBatch" : "EntityTick", entityCount, tickCount, elapsed * 1000,
+            elapsed * 1e9 / ((double)entityCount * tickCount), sizeof(Entity));
+
+        delete db;
+    }
+
+    // Spawn/destroy churn: replace a random 10% of a full pool every round, then look everyone up
+    // by id like the snapshot and relevance code does every tick.
+    {
+        const int roundCount = 100;
+        const int churnCount = entityCount / 10;
+
+        EntityDB *db = new EntityDB;
+        std::vector<uint32_t> ids{};
+        for (int i = 0; i < entityCount; i++) {
+            ids.push_back(db->SpawnEntity(Entity::TYP_NPC, 0)->id);
+        }
+
+        uint32_t rng = 0x9E3779B9;
+        double churnElapsed = 0;
+        double findElapsed = 0;
+        size_t found = 0;
+        for (int round = 0; round < roundCount; round++) {
+            const double churnStartedAt = yojimbo_time();
+            for (int i = 0; i < churnCount; i++) {
+                // xorshift32
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                uint32_t &id = ids[rng % ids.size()];
+                db->DestroyEntity(id);
+                id = db->SpawnEntity(Entity::TYP_NPC, round)->id;
+            }
+            const double findStartedAt = yojimbo_time();
+            for (uint32_t id : ids) {
+                found += db->FindEntity(id) != 0;
+            }
+            churnElapsed += findStartedAt - churnStartedAt;
+            findElapsed += yojimbo_time() - findStartedAt;
+        }
+        assert(found == (size_t)roundCount * entityCount);
+
+        printf("[entity_db] Churn: %d entities, %d rounds of %d destroy+spawn (%.2f ns each), %.2f ns/FindEntity (%zu found)\n",
+            entityCount, roundCount, churnCount,
+            churnElapsed * 1e9 / ((double)roundCount * churnCount),
+            findElapsed * 1e9 / ((double)roundCount * entityCount), found);
+
+        delete db;
+    }
+}
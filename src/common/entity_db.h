@@ -3,20 +3,123 @@
 #include "data.h"
 
 struct EntityDB {
-    std::unordered_map<uint32_t, size_t>     entities_by_id {};
-    std::array<Entity     , SV_MAX_ENTITIES> entities       {};
-    std::array<AspectGhost, SV_MAX_ENTITIES> ghosts         {};
+    // Pool storage, allocated a page at a time so the pool can grow without moving anything
+    // (Entity::cold/ghost and everyone's Entity * stay valid). Pages are only allocated when a
+    // slot in them is used, clients only get the entities that are relevant to them and those
+    // are spread all over the server's pool.
+    template <typename T>
+    struct PagedArray {
+        std::vector<std::unique_ptr<T[]>> pages{};
+
+        struct Iterator {
+            PagedArray *array {};
+            size_t      index {};
+
+            T &operator*(void) const { return (*array)[index]; }
+            bool operator!=(const Iterator &other) const { return index != other.index; }
+            Iterator &operator++(void) {
+                index++;
+                index = array->SkipEmptyPages(index);
+                return *this;
+            }
+        };
+
+        size_t size(void) const { return pages.size() * SV_ENTITY_POOL_PAGE_SIZE; }
+        bool Has(size_t index) const
+        {
+            const size_t page = index / SV_ENTITY_POOL_PAGE_SIZE;
+            return page < pages.size() && pages[page];
+        }
+        void Grow(size_t index)
+        {
+            const size_t page = index / SV_ENTITY_POOL_PAGE_SIZE;
+            if (page >= pages.size()) {
+                pages.resize(page + 1);
+            }
+            if (!pages[page]) {
+                pages[page] = std::make_unique<T[]>(SV_ENTITY_POOL_PAGE_SIZE);
+            }
+        }
+        size_t SkipEmptyPages(size_t index) const
+        {
+            while (index < size() && !pages[index / SV_ENTITY_POOL_PAGE_SIZE]) {
+                index = (index / SV_ENTITY_POOL_PAGE_SIZE + 1) * SV_ENTITY_POOL_PAGE_SIZE;
+            }
+            return index;
+        }
+
+        T &operator[](size_t index)
+        {
+            assert(Has(index));
+            return pages[index / SV_ENTITY_POOL_PAGE_SIZE][index % SV_ENTITY_POOL_PAGE_SIZE];
+        }
+        Iterator begin(void) { return { this, SkipEmptyPages(0) }; }
+        Iterator end(void) { return { this, size() }; }
+    };
+
+    // Uniform grid over each map, hashed by cell coord so it doesn't need to know how big the
+    // maps are (clients don't always know yet). Entities are filed by their ground position.
+    struct SpatialGrid {
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells{};  // cell key -> entity indices
+    };
+    // Which cell an entity is currently filed in
+    struct SpatialRecord {
+        bool     in_grid {};
+        uint16_t map_id  {};
+        int32_t  cell_x  {};
+        int32_t  cell_y  {};
+    };
+
+    // Entity ids are generational handles: the low SV_ENTITY_GENERATION_BITS are the generation
+    // of the slot, the rest is the slot's index. Freeing a slot bumps its generation, so ids
+    // held onto after the entity is destroyed don't find whoever gets the slot next.
+    static uint32_t EntityIdIndex(uint32_t entity_id) { return entity_id >> SV_ENTITY_GENERATION_BITS; }
+    static uint32_t EntityIdGeneration(uint32_t entity_id) { return entity_id & ((1u << SV_ENTITY_GENERATION_BITS) - 1); }
+    static uint32_t EntityIdMake(uint32_t index, uint32_t generation) { return (index << SV_ENTITY_GENERATION_BITS) | generation; }
+
+    PagedArray<Entity       > entities    {};
+    PagedArray<EntityCold   > cold        {};  // rarely touched data, see Entity::cold
+    PagedArray<AspectGhost  > ghosts      {};
+    PagedArray<SpatialRecord> spatial     {};
+    PagedArray<uint8_t      > generations {};  // generation of the next entity to use each slot
+    std::queue<uint32_t>      free_slots  {};  // FIFO so slots (and their generations) get reused as rarely as possible
+    uint32_t                  next_slot   {1};  // slot 0 is never used, so entity id 0 means "no entity"
+
+    std::unordered_map<uint16_t, SpatialGrid> grids {};  // map id -> grid
 
     Entity *FindEntity(uint32_t entity_id, bool evenIfDespawned = false);
     Entity *FindEntity(uint32_t entity_id, Entity::Type type, bool evenIfDespawned = false);
+    // Allocate a new id (server)
+    Entity *SpawnEntity(Entity::Type type, double now);
+    // Use an id that was already allocated (client, for entities the server told us about)
     Entity *SpawnEntity(uint32_t entity_id, Entity::Type type, double now);
     bool DespawnEntity(uint32_t entity_id, double now);
     void DestroyEntity(uint32_t entity_id);
 
     void EntityTick(Entity &entity, double dt, double now);
+    // Same thing as calling EntityTick on each of them (bit for bit), just faster. Entities
+    // don't have to be in the pool.
+    void EntityTickBatch(Entity *const *batch, size_t count, double dt, double now);
+
+    // Call after changing an entity's position or map (EntityTick does this for you)
+    void UpdateSpatial(Entity &entity);
+    // Entities (not despawned) whose ground position is inside the rect/circle. Positions aren't
+    // extents, so pad by SV_ENTITY_MAX_EXTENT if you're going to test against e.g. sprite rects.
+    void QueryRect(uint16_t map_id, Rectangle rect, std::vector<Entity *> &results);
+    void QueryRadius(uint16_t map_id, Vector2 center, float radius, std::vector<Entity *> &results);
 
     void DrawEntityId(Entity &entity, Camera2D &camera);
     void DrawEntity(Entity &entity, DrawCmdQueue &sortedDraws, bool highlight = false);
+
+private:
+    static float EntityDamping(float drag, double dt);
+
+    Entity *SpawnEntityAt(uint32_t index, uint32_t entity_id, Entity::Type type, double now);
+    uint32_t SlotIndex(const Entity &entity);
+    void RemoveSpatial(uint32_t index);
 };
 
-extern EntityDB *entityDb;
\ No newline at end of file
+extern EntityDB *entityDb;
+
+void EntityDBTests(void);
+void EntityDBBenchmark(void);
\ No newline at end of file
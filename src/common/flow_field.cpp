@@ -0,0 +1,182 @@
+#include "flow_field.h"
+#include "grid_dijkstra.h"
+#include "data.h"
+
+// N, E, S, W, then the diagonals NE, SE, SW, NW
+const int8_t FlowField::STEP_DX[8]{  0, 1, 0, -1,  1, 1, -1, -1 };
+const int8_t FlowField::STEP_DY[8]{ -1, 0, 1,  0, -1, 1,  1, -1 };
+
+void FlowField::Compute(Tilemap &map, uint16_t goal_x, uint16_t goal_y)
+{
+    thread_local std::vector<uint8_t> open{};
+    thread_local std::vector<uint32_t> cost{};
+
+    this->goal_x = goal_x;
+    this->goal_y = goal_y;
+    solidVersion = map.solidVersion;
+    x0 = (uint16_t)MAX(0, (int)goal_x - radius);
+    y0 = (uint16_t)MAX(0, (int)goal_y - radius);
+    w = (uint16_t)(MIN((int)map.width - 1, (int)goal_x + radius) - x0 + 1);
+    h = (uint16_t)(MIN((int)map.height - 1, (int)goal_y + radius) - y0 + 1);
+    steps.assign((size_t)w * h, (uint8_t)STEP_NONE);
+
+    // Open tiles in the window, with a ring of solid tiles around it so steps never leave it
+    const int pw = w + 2;
+    const int ph = h + 2;
+    open.assign((size_t)pw * ph, 0);
+    for (int y = 0; y < h; y++) {
+        const uint64_t *row = map.SolidRow(y0 + y);
+        for (int x = 0; x < w; x++) {
+            const uint32_t bit = (uint32_t)(x0 + x) + 1;
+            open[(size_t)(y + 1) * pw + x + 1] = !((row[bit >> 6] >> (bit & 63)) & 1);
+        }
+    }
+
+    int stepOffset[8]{};
+    for (int step = 0; step < 8; step++) {
+        stepOffset[step] = STEP_DY[step] * pw + STEP_DX[step];
+    }
+    // No cutting corners, both tiles beside a diagonal step have to be open too
+    const auto canStep = [&](uint32_t p, int step) {
+        if (!open[p + stepOffset[step]]) {
+            return false;
+        }
+        return step < 4 || (open[p + STEP_DX[step]] && open[p + STEP_DY[step] * pw]);
+    };
+    const auto stepCost = [](int step) {
+        return step < 4 ? GRID_COST_STRAIGHT : GRID_COST_DIAGONAL;
+    };
+
+    const uint32_t goal = (uint32_t)(goal_y - y0 + 1) * pw + (goal_x - x0 + 1);
+    if (!open[goal]) {
+        return;
+    }
+
+    // Distance from the goal to every tile (moves are symmetric, so it's the same the other way)
+    cost.assign((size_t)pw * ph, UINT32_MAX);
+    GridDijkstra(goal, cost.data(),
+        [&](uint32_t p, auto next) {
+            for (int step = 0; step < 8; step++) {
+                if (canStep(p, step)) {
+                    next(p + stepOffset[step], stepCost(step));
+                }
+            }
+        },
+        [](uint32_t) { return true; }
+    );
+
+    // Each tile steps to the neighbor its shortest path to the goal goes through, i.e. the one
+    // with the lowest cost of getting there plus the rest of the way. Straight steps win ties.
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const uint32_t p = (uint32_t)(y + 1) * pw + x + 1;
+            if (cost[p] == UINT32_MAX) {
+                continue;
+            }
+            if (p == goal) {
+                steps[(size_t)y * w + x] = STEP_GOAL;
+                continue;
+            }
+            uint32_t best = UINT32_MAX;
+            for (int step = 0; step < 8; step++) {
+                if (!canStep(p, step) || cost[p + stepOffset[step]] == UINT32_MAX) {
+                    continue;
+                }
+                const uint32_t viaStep = cost[p + stepOffset[step]] + stepCost(step);
+                if (viaStep < best) {
+                    best = viaStep;
+                    steps[(size_t)y * w + x] = (uint8_t)step;
+                }
+            }
+            assert(best == cost[p]);
+        }
+    }
+}
+
+void FlowFieldBenchmark(void)
+{
+    Tilemap *map = BenchmarkTilemap("flow_field", 256, 256, 8, 16);
+    if (!map) {
+        return;
+    }
+
+    const int agentCount = 500;
+    const int tickCount = 1000;
+    const int anyaCount = 50;
+    const uint32_t goalKey = 1;
+
+    uint32_t rng = 1234;
+    const auto randomInt = [&](int max) {
+        rng = rng * 1664525u + 1013904223u;
+        return (int)((rng >> 8) % max);
+    };
+
+    // Goal wanders around the middle of the map, agents start scattered around it
+    Tilemap::Coord goal{ map->width / 2, map->height / 2 };
+    while (map->IsSolid(goal.x, goal.y)) {
+        goal.x++;
+    }
+    std::vector<Tilemap::Coord> agents{};
+    while (agents.size() < agentCount) {
+        const Tilemap::Coord agent{
+            goal.x - SV_FLOW_FIELD_RADIUS + randomInt(SV_FLOW_FIELD_RADIUS * 2 + 1),
+            goal.y - SV_FLOW_FIELD_RADIUS + randomInt(SV_FLOW_FIELD_RADIUS * 2 + 1)
+        };
+        if (!map->IsSolid(agent.x, agent.y)) {
+            agents.push_back(agent);
+        }
+    }
+    const std::vector<Tilemap::Coord> agentsAtStart = agents;
+
+    // One field shared by every agent, recomputed when the goal moves to another tile
+    int goalMoves = 0;
+    int arrived = 0;
+    double computeTime = 0;
+    double startedAt = yojimbo_time();
+    for (int tick = 0; tick < tickCount; tick++) {
+        if (tick % 10 == 0) {
+            const int step = randomInt(4);
+            const Tilemap::Coord moved{ goal.x + FlowField::STEP_DX[step], goal.y + FlowField::STEP_DY[step] };
+            if (!map->IsSolid(moved.x, moved.y)) {
+                goal = moved;
+                goalMoves++;
+            }
+        }
+
+        const double computeStartedAt = yojimbo_time();
+        const FlowField &field = map->FlowTo(goalKey, goal, SV_FLOW_FIELD_RADIUS, tick * SV_TICK_DT);
+        computeTime += yojimbo_time() - computeStartedAt;
+
+        for (Tilemap::Coord &agent : agents) {
+            Tilemap::Coord next{};
+            if (field.NextTile(agent.x, agent.y, next.x, next.y)) {
+                arrived += next == agent && agent == goal;
+                agent = next;
+            }
+        }
+    }
+    const double flowTime = yojimbo_time() - startedAt;
+
+    // Versus each agent searching on its own, once
+    int anyaFound = 0;
+    startedAt = yojimbo_time();
+    for (int i = 0; i < anyaCount; i++) {
+        Anya_State &state = Anya_ThreadState();
+        state.Reset(
+            { (float)agentsAtStart[i].x, (float)agentsAtStart[i].y },
+            { (float)goal.x, (float)goal.y },
+            Tilemap::Tilemap_AnyaSolidQuery, map
+        );
+        Anya(state);
+        anyaFound += !state.path.empty();
+    }
+    const double anyaTime = yojimbo_time() - startedAt;
+
+    printf("[flow_field] %dx%d map, radius %d, %d agents: %.3f ms/tick, %.3f ms/goal move (%d moves, %d agent-ticks at goal)\n",
+        map->width, map->height, SV_FLOW_FIELD_RADIUS, agentCount, flowTime * 1000 / tickCount,
+        computeTime * 1000 / MAX(1, goalMoves), goalMoves, arrived);
+    printf("[flow_field] anya per agent: %.0f us/query (found %d/%d), %.3f ms for all %d agents\n",
+        anyaTime * 1e6 / anyaCount, anyaFound, anyaCount, anyaTime * 1000 / anyaCount * agentCount, agentCount);
+
+    delete map;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+
+struct Tilemap;
+
+// Every tile within radius of a goal tile knows which neighbor to step to next to get there, so
+// any number of entities heading for the same goal can each find their way with a lookup instead
+// of a search of their own (see Tilemap::FlowTo).
+//
+// NOTE(dlb): Steps are 8-way and don't cut corners, same as the distances in hpa.cpp
+struct FlowField {
+    static const uint8_t STEP_GOAL = 8;     // standing on the goal
+    static const uint8_t STEP_NONE = 0xFF;  // solid, or no way to the goal within the field
+
+    uint32_t             key          {};  // what the field leads to, e.g. the goal entity's id
+    uint16_t             goal_x       {};  // tile coords
+    uint16_t             goal_y       {};
+    uint16_t             radius       {};  // in tiles, along either axis
+    uint16_t             x0           {};  // window the field covers, radius around the goal clipped to the map
+    uint16_t             y0           {};
+    uint16_t             w            {};
+    uint16_t             h            {};
+    uint32_t             solidVersion {};  // Tilemap::solidVersion it was computed at
+    double               lastUsedAt   {};
+    std::vector<uint8_t> steps        {};  // w * h, index into STEP_DX/DY or STEP_GOAL/NONE
+
+    static const int8_t STEP_DX[8];
+    static const int8_t STEP_DY[8];
+
+    // Recomputes the whole window around the new goal
+    void Compute(Tilemap &map, uint16_t goal_x, uint16_t goal_y);
+
+    // Tile to step to from tile x,y (the goal itself, once there). Returns false if x,y is outside
+    // the field or can't get to the goal from there.
+    inline bool NextTile(int x, int y, int &next_x, int &next_y) const
+    {
+        if ((unsigned)(x - x0) >= w || (unsigned)(y - y0) >= h) {
+            return false;
+        }
+        const uint8_t step = steps[(size_t)(y - y0) * w + (x - x0)];
+        if (step == STEP_NONE) {
+            return false;
+        }
+        next_x = step == STEP_GOAL ? x : x + STEP_DX[step];
+        next_y = step == STEP_GOAL ? y : y + STEP_DY[step];
+        return true;
+    }
+};
+
+void FlowFieldBenchmark(void);
@@ -0,0 +1,50 @@
+#pragma once
+#include "common.h"
+
+// Fixed point costs of an 8-way step on the tile grid. 99/70 is a hair over sqrt 2, so distances
+// are never shorter than the straight line between two tiles (e.g. an A* heuristic).
+#define GRID_COST_STRAIGHT  70
+#define GRID_COST_DIAGONAL  99
+
+// Dijkstra out from source, over whatever cells forEachStep says are connected. Every step costs
+// less than 100, so the open list is a ring of 100 buckets instead of a heap.
+//   cost         1 per cell, filled with UINT32_MAX by the caller. Distances from source when done.
+//   forEachStep  (cell, step) calls step(next, GRID_COST_*) for every cell one step away from cell
+//   settled      (cell) once its cost is final, return false to stop early
+template <typename ForEachStep, typename Settled>
+void GridDijkstra(uint32_t source, uint32_t *cost, ForEachStep forEachStep, Settled settled)
+{
+    const uint32_t BUCKETS = GRID_COST_DIAGONAL + 1;
+    static_assert(GRID_COST_STRAIGHT > 0 && GRID_COST_DIAGONAL < BUCKETS, "steps have to land in another bucket");
+    thread_local std::vector<uint32_t> buckets[BUCKETS]{};
+
+    cost[source] = 0;
+    buckets[0].push_back(source);
+    size_t queued = 1;
+    for (uint32_t c = 0; queued; c++) {
+        // NOTE(dlb): Steps always land in a different bucket, so this one can't grow while we walk it
+        std::vector<uint32_t> &bucket = buckets[c % BUCKETS];
+        for (size_t i = 0; i < bucket.size(); i++) {
+            const uint32_t cell = bucket[i];
+            queued--;
+            if (cost[cell] != c) {
+                continue;  // stale, it was queued again with a lower cost
+            }
+            if (!settled(cell)) {
+                // Don't leave anything behind for the next search
+                for (std::vector<uint32_t> &leftover : buckets) {
+                    leftover.clear();
+                }
+                return;
+            }
+            forEachStep(cell, [&](uint32_t next, uint32_t stepCost) {
+                if (c + stepCost < cost[next]) {
+                    cost[next] = c + stepCost;
+                    buckets[(c + stepCost) % BUCKETS].push_back(next);
+                    queued++;
+                }
+            });
+        }
+        bucket.clear();
+    }
+}
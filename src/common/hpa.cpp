@@ -0,0 +1,599 @@
+#include "hpa.h"
+#include "grid_dijkstra.h"
+#include "data.h"
+
+static const uint64_t HPA_ROW_MASK = HPA_CLUSTER_W == 64 ? ~0ull : (1ull << (HPA_CLUSTER_W & 63)) - 1;
+
+uint64_t Hpa_SolidView::Row64(int x, int y) const
+{
+    assert(y >= 0 && y < height);
+    const uint64_t *row = &bits[(size_t)(y + 1) * stride];
+    const uint32_t bit = (uint32_t)x + 1;
+    const uint32_t word = bit >> 6;
+    const uint32_t shift = bit & 63;
+    uint64_t value = word < stride ? row[word] >> shift : ~0ull;
+    if (shift) {
+        value |= (word + 1 < stride ? row[word + 1] : ~0ull) << (64 - shift);
+    }
+    return value;
+}
+bool Hpa_SolidView::AnyaSolidQuery(int x, int y, void *userdata)
+{
+    const Hpa_SolidView *solid = (const Hpa_SolidView *)userdata;
+    return solid->IsSolid(x, y);
+}
+
+// Cluster-wide row starting at tile x, rows below the map are solid
+static uint64_t Hpa_ReadRow(const Hpa_SolidView &solid, int x, int y)
+{
+    if (y >= solid.height) {
+        return HPA_ROW_MASK;
+    }
+    return solid.Row64(x, y) & HPA_ROW_MASK;
+}
+
+struct Hpa_OpenCell {
+    float cost;
+    uint32_t id;
+
+    bool operator<(const Hpa_OpenCell &rhs) const
+    {
+        return cost > rhs.cost;
+    }
+};
+
+// Distance from local tile sx,sy to every tile in the cluster, moving 8-way without cutting
+// corners. dist is HPA_CLUSTER_W^2, INFINITY where it can't get to. If stopAt is given (1 bit per
+// tile, like rows), only the distances to those tiles are needed and it stops once it has them.
+static void Hpa_ClusterDistances(const uint64_t *rows, int sx, int sy, float *dist, const uint64_t *stopAt = 0)
+{
+    thread_local uint32_t cost[HPA_CLUSTER_W * HPA_CLUSTER_W]{};
+
+    std::fill(dist, dist + HPA_CLUSTER_W * HPA_CLUSTER_W, INFINITY);
+    if ((rows[sy] >> sx) & 1) {
+        return;
+    }
+
+    // Which tiles can step in each direction, 1 word per row like rows
+    enum { MOVE_N, MOVE_E, MOVE_S, MOVE_W, MOVE_NE, MOVE_SE, MOVE_SW, MOVE_NW, MOVE_COUNT };
+    const int moveDx[MOVE_COUNT]{ 0, 1, 0, -1, 1, 1, -1, -1 };
+    const int moveDy[MOVE_COUNT]{ -1, 0, 1, 0, -1, 1, 1, -1 };
+    uint64_t moves[MOVE_COUNT][HPA_CLUSTER_W]{};
+    for (int y = 0; y < HPA_CLUSTER_W; y++) {
+        const uint64_t open = ~rows[y] & HPA_ROW_MASK;
+        const uint64_t openN = y > 0 ? ~rows[y - 1] & HPA_ROW_MASK : 0;
+        const uint64_t openS = y + 1 < HPA_CLUSTER_W ? ~rows[y + 1] & HPA_ROW_MASK : 0;
+        moves[MOVE_N][y] = open & openN;
+        moves[MOVE_E][y] = open & (open >> 1);
+        moves[MOVE_S][y] = open & openS;
+        moves[MOVE_W][y] = open & (open << 1);
+        // No cutting corners, both tiles beside the diagonal have to be open too
+        moves[MOVE_NE][y] = moves[MOVE_N][y] & moves[MOVE_E][y] & (openN >> 1);
+        moves[MOVE_SE][y] = moves[MOVE_S][y] & moves[MOVE_E][y] & (openS >> 1);
+        moves[MOVE_SW][y] = moves[MOVE_S][y] & moves[MOVE_W][y] & (openS << 1);
+        moves[MOVE_NW][y] = moves[MOVE_N][y] & moves[MOVE_W][y] & (openN << 1);
+    }
+    int remaining = 0;
+    if (stopAt) {
+        for (int i = 0; i < HPA_CLUSTER_W; i++) {
+            remaining += std::popcount(stopAt[i]);
+        }
+    }
+
+    std::fill(cost, cost + HPA_CLUSTER_W * HPA_CLUSTER_W, UINT32_MAX);
+    GridDijkstra((uint32_t)(sy * HPA_CLUSTER_W + sx), cost,
+        [&](uint32_t id, auto step) {
+            const int x = id % HPA_CLUSTER_W;
+            const int y = id / HPA_CLUSTER_W;
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                if ((moves[move][y] >> x) & 1) {
+                    step((uint32_t)((y + moveDy[move]) * HPA_CLUSTER_W + x + moveDx[move]),
+                        move >= MOVE_NE ? GRID_COST_DIAGONAL : GRID_COST_STRAIGHT);
+                }
+            }
+        },
+        [&](uint32_t id) {
+            // Keep going until we've got every tile in stopAt
+            return !stopAt || !((stopAt[id / HPA_CLUSTER_W] >> (id % HPA_CLUSTER_W)) & 1) || --remaining;
+        }
+    );
+
+    for (int i = 0; i < HPA_CLUSTER_W * HPA_CLUSTER_W; i++) {
+        if (cost[i] != UINT32_MAX) {
+            dist[i] = (float)cost[i] / GRID_COST_STRAIGHT;
+        }
+    }
+}
+
+int Hpa_Graph::FindNode(uint32_t clusterIdx, int x, int y) const
+{
+    const std::vector<Hpa_Node> &nodes = clusters[clusterIdx]->nodes;
+    for (int i = 0; i < nodes.size(); i++) {
+        if (nodes[i].x == x && nodes[i].y == y) {
+            return i;
+        }
+    }
+    return -1;
+}
+std::shared_ptr<const Hpa_Cluster> Hpa_Graph::BuildCluster(const Hpa_SolidView &solid, int cx, int cy) const
+{
+    std::shared_ptr<Hpa_Cluster> cluster = std::make_shared<Hpa_Cluster>();
+    const int x0 = cx * HPA_CLUSTER_W;
+    const int y0 = cy * HPA_CLUSTER_W;
+    uint64_t *rows = cluster->bits;
+    for (int i = 0; i < HPA_CLUSTER_W; i++) {
+        rows[i] = Hpa_ReadRow(solid, x0, y0 + i);
+    }
+
+    // Tiles open on both sides of each border, bit i = i-th tile along it (columns are transposed)
+    enum { BORDER_N, BORDER_E, BORDER_S, BORDER_W, BORDER_COUNT };
+    uint64_t open[BORDER_COUNT]{};
+    if (cy > 0) {
+        open[BORDER_N] = ~rows[0] & ~Hpa_ReadRow(solid, x0, y0 - 1) & HPA_ROW_MASK;
+    }
+    if (cy + 1 < clustersH) {
+        open[BORDER_S] = ~rows[HPA_CLUSTER_W - 1] & ~Hpa_ReadRow(solid, x0, y0 + HPA_CLUSTER_W) & HPA_ROW_MASK;
+    }
+    for (int i = 0; i < HPA_CLUSTER_W; i++) {
+        if (cx > 0 && !(rows[i] & 1) && !solid.IsSolid(x0 - 1, y0 + i)) {
+            open[BORDER_W] |= 1ull << i;
+        }
+        if (cx + 1 < clustersW && !((rows[i] >> (HPA_CLUSTER_W - 1)) & 1) && !solid.IsSolid(x0 + HPA_CLUSTER_W, y0 + i)) {
+            open[BORDER_E] |= 1ull << i;
+        }
+    }
+
+    // NOTE(dlb): The cluster on the other side finds the same entrances and puts its portals
+    // right across from ours, which is how FindWaypoints gets from one cluster to the next.
+    const auto addPortal = [&](int border, int i) {
+        Hpa_Node node{};
+        switch (border) {
+            case BORDER_N: node = { (uint16_t)(x0 + i), (uint16_t)y0 }; break;
+            case BORDER_E: node = { (uint16_t)(x0 + HPA_CLUSTER_W - 1), (uint16_t)(y0 + i) }; break;
+            case BORDER_S: node = { (uint16_t)(x0 + i), (uint16_t)(y0 + HPA_CLUSTER_W - 1) }; break;
+            case BORDER_W: node = { (uint16_t)x0, (uint16_t)(y0 + i) }; break;
+        }
+        for (const Hpa_Node &existing : cluster->nodes) {
+            if (existing.x == node.x && existing.y == node.y) {
+                return;  // corner tile, already a portal on the other border
+            }
+        }
+        cluster->nodes.push_back(node);
+    };
+    for (int border = 0; border < BORDER_COUNT; border++) {
+        const uint64_t bits = open[border];
+        for (int i = 0; i < HPA_CLUSTER_W;) {
+            if (!((bits >> i) & 1)) {
+                i++;
+                continue;
+            }
+            const int start = i;
+            while (i < HPA_CLUSTER_W && ((bits >> i) & 1)) {
+                i++;
+            }
+            const int len = i - start;
+            if (len <= HPA_MAX_ENTRANCE_LEN) {
+                addPortal(border, start + (len - 1) / 2);
+            } else {
+                addPortal(border, start);
+                addPortal(border, i - 1);
+            }
+        }
+    }
+
+    // Distances are the same both ways, so each search only needs the portals after it
+    const size_t nodeCount = cluster->nodes.size();
+    cluster->dist.resize(nodeCount * nodeCount);
+    thread_local std::vector<float> dist(HPA_CLUSTER_W * HPA_CLUSTER_W);
+    uint64_t stopAt[HPA_CLUSTER_W]{};
+    for (const Hpa_Node &node : cluster->nodes) {
+        stopAt[node.y - y0] |= 1ull << (node.x - x0);
+    }
+    for (size_t i = 0; i < nodeCount; i++) {
+        const Hpa_Node &from = cluster->nodes[i];
+        stopAt[from.y - y0] &= ~(1ull << (from.x - x0));
+        cluster->dist[i * nodeCount + i] = 0;
+        if (i + 1 == nodeCount) {
+            break;
+        }
+        Hpa_ClusterDistances(rows, from.x - x0, from.y - y0, dist.data(), stopAt);
+        for (size_t j = i + 1; j < nodeCount; j++) {
+            const Hpa_Node &to = cluster->nodes[j];
+            cluster->dist[i * nodeCount + j] = dist[(to.y - y0) * HPA_CLUSTER_W + to.x - x0];
+            cluster->dist[j * nodeCount + i] = cluster->dist[i * nodeCount + j];
+        }
+    }
+    return cluster;
+}
+
+int Hpa_Graph::Update(const Hpa_SolidView &solid, const std::vector<uint32_t> &changed)
+{
+    int rebuilt = 0;
+    if (clusters.empty() || solid.width != width || solid.height != height) {
+        width = solid.width;
+        height = solid.height;
+        clustersW = (width + HPA_CLUSTER_W - 1) / HPA_CLUSTER_W;
+        clustersH = (height + HPA_CLUSTER_W - 1) / HPA_CLUSTER_W;
+        clusters.assign((size_t)clustersW * clustersH, {});
+        for (uint32_t clusterIdx = 0; clusterIdx < clusters.size(); clusterIdx++) {
+            clusters[clusterIdx] = BuildCluster(solid, clusterIdx % clustersW, clusterIdx / clustersW);
+            rebuilt++;
+        }
+    } else {
+        // Diff the changed clusters against the solidity they were built from, so we know which
+        // borders moved (and whether anything changed at all, e.g. a door opened and closed again)
+        enum { CHANGED = 1, CHANGED_N = 2, CHANGED_E = 4, CHANGED_S = 8, CHANGED_W = 16 };
+        thread_local std::vector<uint8_t> rebuild{};
+        rebuild.assign(clusters.size(), 0);
+        for (uint32_t clusterIdx : changed) {
+            if (clusterIdx >= clusters.size()) {
+                assert(!"cluster index out of bounds");
+                continue;
+            }
+            const int cx = clusterIdx % clustersW;
+            const int cy = clusterIdx / clustersW;
+            const uint64_t *old = clusters[clusterIdx]->bits;
+            uint8_t flags = 0;
+            uint64_t colsChanged = 0;
+            for (int i = 0; i < HPA_CLUSTER_W; i++) {
+                const uint64_t row = Hpa_ReadRow(solid, cx * HPA_CLUSTER_W, cy * HPA_CLUSTER_W + i);
+                colsChanged |= row ^ old[i];
+                if (row != old[i]) {
+                    flags |= CHANGED;
+                    if (i == 0) flags |= CHANGED_N;
+                    if (i == HPA_CLUSTER_W - 1) flags |= CHANGED_S;
+                }
+            }
+            if (colsChanged & 1) flags |= CHANGED_W;
+            if ((colsChanged >> (HPA_CLUSTER_W - 1)) & 1) flags |= CHANGED_E;
+
+            // Neighbors' portals on a changed border move too
+            rebuild[clusterIdx] |= flags & CHANGED;
+            if (cy > 0 && (flags & CHANGED_N)) rebuild[clusterIdx - clustersW] = CHANGED;
+            if (cy + 1 < clustersH && (flags & CHANGED_S)) rebuild[clusterIdx + clustersW] = CHANGED;
+            if (cx > 0 && (flags & CHANGED_W)) rebuild[clusterIdx - 1] = CHANGED;
+            if (cx + 1 < clustersW && (flags & CHANGED_E)) rebuild[clusterIdx + 1] = CHANGED;
+        }
+
+        for (uint32_t clusterIdx = 0; clusterIdx < clusters.size(); clusterIdx++) {
+            if (rebuild[clusterIdx]) {
+                clusters[clusterIdx] = BuildCluster(solid, clusterIdx % clustersW, clusterIdx / clustersW);
+                rebuilt++;
+            }
+        }
+        if (!rebuilt) {
+            return 0;
+        }
+    }
+
+    nodeBase.resize(clusters.size());
+    nodeCount = 0;
+    for (size_t i = 0; i < clusters.size(); i++) {
+        nodeBase[i] = nodeCount;
+        nodeCount += clusters[i]->nodes.size();
+    }
+    return rebuilt;
+}
+
+bool Hpa_Graph::FindWaypoints(const Hpa_SolidView &solid, Vector2 start, Vector2 target, std::vector<Vector2> &waypoints) const
+{
+    assert(solid.width == width && solid.height == height);
+    waypoints.clear();
+
+    const int sx = (int)start.x;
+    const int sy = (int)start.y;
+    const int tx = (int)target.x;
+    const int ty = (int)target.y;
+    if (solid.IsSolid(sx, sy) || solid.IsSolid(tx, ty)) {
+        return false;
+    }
+
+    struct Search {
+        std::vector<float> cost{};
+        std::vector<int> parent{};
+        std::vector<uint8_t> closed{};
+        std::vector<Hpa_OpenCell> open{};
+        float startDist[HPA_CLUSTER_W * HPA_CLUSTER_W]{};
+        float targetDist[HPA_CLUSTER_W * HPA_CLUSTER_W]{};
+    };
+    thread_local Search search{};
+
+    const uint32_t startCluster = ClusterAt(sx, sy);
+    const uint32_t targetCluster = ClusterAt(tx, ty);
+    const Hpa_Cluster &startC = *clusters[startCluster];
+    const Hpa_Cluster &targetC = *clusters[targetCluster];
+    const int sx0 = sx / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    const int sy0 = sy / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    const int tx0 = tx / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    const int ty0 = ty / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    uint64_t stopAt[HPA_CLUSTER_W]{};
+    for (const Hpa_Node &node : startC.nodes) {
+        stopAt[node.y - sy0] |= 1ull << (node.x - sx0);
+    }
+    if (startCluster == targetCluster) {
+        stopAt[ty - ty0] |= 1ull << (tx - tx0);
+    }
+    Hpa_ClusterDistances(startC.bits, sx - sx0, sy - sy0, search.startDist, stopAt);
+    if (startCluster == targetCluster && search.startDist[(ty - ty0) * HPA_CLUSTER_W + tx - tx0] != INFINITY) {
+        waypoints.push_back(start);
+        waypoints.push_back(target);
+        return true;
+    }
+    memset(stopAt, 0, sizeof(stopAt));
+    for (const Hpa_Node &node : targetC.nodes) {
+        stopAt[node.y - ty0] |= 1ull << (node.x - tx0);
+    }
+    Hpa_ClusterDistances(targetC.bits, tx - tx0, ty - ty0, search.targetDist, stopAt);
+
+    // Portal ids are nodeBase[cluster] + index within cluster, target is one past the last portal
+    const uint32_t goal = nodeCount;
+    search.cost.assign(nodeCount + 1, INFINITY);
+    search.parent.assign(nodeCount + 1, -1);
+    search.closed.assign(nodeCount + 1, 0);
+    search.open.clear();
+
+    const auto push = [&](uint32_t id, float cost, int parent, const Hpa_Node *node) {
+        if (cost < search.cost[id]) {
+            search.cost[id] = cost;
+            search.parent[id] = parent;
+            const float heuristic = node ? Vector2Distance({ (float)node->x, (float)node->y }, target) : 0;
+            search.open.push_back({ cost + heuristic, id });
+            std::push_heap(search.open.begin(), search.open.end());
+        }
+    };
+    for (size_t i = 0; i < startC.nodes.size(); i++) {
+        const Hpa_Node &node = startC.nodes[i];
+        push(nodeBase[startCluster] + i, search.startDist[(node.y - sy0) * HPA_CLUSTER_W + node.x - sx0], -1, &node);
+    }
+
+    while (!search.open.empty()) {
+        const uint32_t id = search.open.front().id;
+        std::pop_heap(search.open.begin(), search.open.end());
+        search.open.pop_back();
+        if (search.closed[id]) {
+            continue;
+        }
+        search.closed[id] = 1;
+        if (id == goal) {
+            break;
+        }
+
+        const uint32_t clusterIdx = std::upper_bound(nodeBase.begin(), nodeBase.end(), id) - nodeBase.begin() - 1;
+        const Hpa_Cluster &cluster = *clusters[clusterIdx];
+        const uint32_t local = id - nodeBase[clusterIdx];
+        const Hpa_Node &node = cluster.nodes[local];
+        const float cost = search.cost[id];
+
+        if (clusterIdx == targetCluster) {
+            push(goal, cost + search.targetDist[(node.y - ty0) * HPA_CLUSTER_W + node.x - tx0], id, 0);
+        }
+
+        // Other portals in the same cluster
+        const size_t clusterNodes = cluster.nodes.size();
+        for (size_t i = 0; i < clusterNodes; i++) {
+            const float dist = cluster.dist[local * clusterNodes + i];
+            if (i != local && dist != INFINITY) {
+                push(nodeBase[clusterIdx] + i, cost + dist, id, &cluster.nodes[i]);
+            }
+        }
+
+        // Portal across the border
+        const int dirs[4][2]{ { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+        for (const auto &dir : dirs) {
+            const int nx = node.x + dir[0];
+            const int ny = node.y + dir[1];
+            if ((unsigned)nx >= width || (unsigned)ny >= height) {
+                continue;
+            }
+            const uint32_t neighborIdx = ClusterAt(nx, ny);
+            if (neighborIdx == clusterIdx) {
+                continue;
+            }
+            const int neighborLocal = FindNode(neighborIdx, nx, ny);
+            if (neighborLocal >= 0) {
+                push(nodeBase[neighborIdx] + neighborLocal, cost + 1, id, &clusters[neighborIdx]->nodes[neighborLocal]);
+            }
+        }
+    }
+
+    if (!search.closed[goal]) {
+        return false;
+    }
+
+    waypoints.push_back(target);
+    for (int id = search.parent[goal]; id >= 0; id = search.parent[id]) {
+        const uint32_t clusterIdx = std::upper_bound(nodeBase.begin(), nodeBase.end(), (uint32_t)id) - nodeBase.begin() - 1;
+        const Hpa_Node &node = clusters[clusterIdx]->nodes[id - nodeBase[clusterIdx]];
+        waypoints.push_back({ (float)node.x, (float)node.y });
+    }
+    waypoints.push_back(start);
+    std::reverse(waypoints.begin(), waypoints.end());
+    return true;
+}
+
+// For when Anya can't find its way from one waypoint to the next (it gives up in some tight
+// spots): walk downhill on the cluster's distance field instead. Only goes straight or at 45
+// degrees, but it always gets there if the waypoints came from FindWaypoints.
+static bool Hpa_ClusterPath(const Hpa_SolidView &solid, Vector2 from, Vector2 to, std::vector<Vector2> &path)
+{
+    thread_local float dist[HPA_CLUSTER_W * HPA_CLUSTER_W]{};
+    const auto tileCenter = [](int x, int y) {
+        return Vector2{ (x + 0.5f) * TILE_W, (y + 0.5f) * TILE_W };
+    };
+
+    const int fx = (int)from.x;
+    const int fy = (int)from.y;
+    const int tx = (int)to.x;
+    const int ty = (int)to.y;
+    const int x0 = tx / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    const int y0 = ty / HPA_CLUSTER_W * HPA_CLUSTER_W;
+    if (fx / HPA_CLUSTER_W * HPA_CLUSTER_W != x0 || fy / HPA_CLUSTER_W * HPA_CLUSTER_W != y0) {
+        // Portal to portal across a border, they're right next to each other
+        path.push_back(tileCenter(fx, fy));
+        path.push_back(tileCenter(tx, ty));
+        return true;
+    }
+
+    uint64_t rows[HPA_CLUSTER_W]{};
+    for (int i = 0; i < HPA_CLUSTER_W; i++) {
+        rows[i] = Hpa_ReadRow(solid, x0, y0 + i);
+    }
+    uint64_t stopAt[HPA_CLUSTER_W]{};
+    stopAt[fy - y0] |= 1ull << (fx - x0);
+    Hpa_ClusterDistances(rows, tx - x0, ty - y0, dist, stopAt);
+    const auto distAt = [](int x, int y) {
+        return (unsigned)x < HPA_CLUSTER_W && (unsigned)y < HPA_CLUSTER_W ? dist[y * HPA_CLUSTER_W + x] : INFINITY;
+    };
+
+    int x = fx - x0;
+    int y = fy - y0;
+    if (distAt(x, y) == INFINITY) {
+        return false;
+    }
+    path.push_back(tileCenter(fx, fy));
+    int prevDx = 0;
+    int prevDy = 0;
+    while (x != tx - x0 || y != ty - y0) {
+        int bestDx = 0;
+        int bestDy = 0;
+        float best = distAt(x, y);
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dx && dy && (distAt(x + dx, y) == INFINITY || distAt(x, y + dy) == INFINITY)) {
+                    continue;  // can't cut corners
+                }
+                if (distAt(x + dx, y + dy) < best) {
+                    best = distAt(x + dx, y + dy);
+                    bestDx = dx;
+                    bestDy = dy;
+                }
+            }
+        }
+        assert(bestDx || bestDy);
+        if ((prevDx || prevDy) && (bestDx != prevDx || bestDy != prevDy)) {
+            path.push_back(tileCenter(x0 + x, y0 + y));  // turn
+        }
+        x += bestDx;
+        y += bestDy;
+        prevDx = bestDx;
+        prevDy = bestDy;
+    }
+    path.push_back(tileCenter(tx, ty));
+    return true;
+}
+
+bool Hpa_FindPath(const Hpa_Graph &graph, const Hpa_SolidView &solid, Vector2 start, Vector2 target, float radius, std::vector<Vector2> &path)
+{
+    thread_local std::vector<Vector2> waypoints{};
+    path.clear();
+    if (!graph.FindWaypoints(solid, start, target, waypoints)) {
+        return false;
+    }
+
+    thread_local std::vector<Vector2> leg{};
+    Anya_State &state = Anya_ThreadState();
+    for (size_t i = 0; i + 1 < waypoints.size(); i++) {
+        state.Reset(waypoints[i], waypoints[i + 1], Hpa_SolidView::AnyaSolidQuery, (void *)&solid);
+        Anya(state, radius, HPA_REFINE_MAX_ITERS);
+        leg.clear();
+        if (state.path.size()) {
+            leg.insert(leg.end(), state.path.begin(), state.path.end());
+        } else if (!Hpa_ClusterPath(solid, waypoints[i], waypoints[i + 1], leg)) {
+            return false;
+        }
+        for (const Vector2 &point : leg) {
+            if (path.empty() || !Vector2Equals(path.back(), point)) {
+                path.push_back(point);
+            }
+        }
+    }
+    return true;
+}
+
+void HpaBenchmark(void)
+{
+    const int sizes[]{ 128, 256, 512, 1024 };
+    const int queryCount = 100;
+    const int flipCount = 100;
+
+    std::vector<Vector2> path{};
+    for (int size : sizes) {
+        Tilemap *map = BenchmarkTilemap("hpa", size, size, 5, 32);
+        if (!map) {
+            return;
+        }
+        // NOTE(dlb): Set flips bits in solidBits in place, so the view stays valid
+        map->SolidRow(-1);
+        const Hpa_SolidView solid{ map->solidBits.data(), map->solidBitsStride, map->width, map->height };
+
+        Hpa_Graph graph{};
+        std::vector<uint32_t> changed{};
+        double startedAt = yojimbo_time();
+        graph.Update(solid, changed);
+        const double buildTime = yojimbo_time() - startedAt;
+
+        // Open tiles at least half the map apart
+        std::vector<std::pair<Vector2, Vector2>> queries{};
+        uint32_t rng = 1234;
+        const auto randomTile = [&](void) {
+            for (;;) {
+                rng = rng * 1664525u + 1013904223u;
+                const int x = (rng >> 8) % size;
+                rng = rng * 1664525u + 1013904223u;
+                const int y = (rng >> 8) % size;
+                if (!solid.IsSolid(x, y)) {
+                    return Vector2{ (float)x, (float)y };
+                }
+            }
+        };
+        while (queries.size() < queryCount) {
+            const Vector2 start = randomTile();
+            const Vector2 target = randomTile();
+            if (fabsf(start.x - target.x) + fabsf(start.y - target.y) >= size / 2) {
+                queries.push_back({ start, target });
+            }
+        }
+
+        int anyaFound = 0;
+        startedAt = yojimbo_time();
+        for (const auto &query : queries) {
+            Anya_State &state = Anya_ThreadState();
+            state.Reset(query.first, query.second, Hpa_SolidView::AnyaSolidQuery, (void *)&solid);
+            Anya(state, 8.0f);
+            anyaFound += !state.path.empty();
+        }
+        const double anyaTime = yojimbo_time() - startedAt;
+
+        int hpaFound = 0;
+        startedAt = yojimbo_time();
+        for (const auto &query : queries) {
+            hpaFound += Hpa_FindPath(graph, solid, query.first, query.second, 8.0f, path);
+        }
+        const double hpaTime = yojimbo_time() - startedAt;
+
+        // One tile flips solidity between updates, only the chunk it's in gets checked
+        int rebuilt = 0;
+        startedAt = yojimbo_time();
+        for (int i = 0; i < flipCount; i++) {
+            const Vector2 tile = randomTile();
+            const uint32_t builtAt = map->solidVersion;
+            BenchmarkToggleTile(*map, (uint16_t)tile.x, (uint16_t)tile.y, 0);
+            changed.clear();
+            for (uint32_t chunkIdx = 0; chunkIdx < map->chunks.size(); chunkIdx++) {
+                if (map->chunks[chunkIdx].solidVersion > builtAt) {
+                    changed.push_back(chunkIdx);
+                }
+            }
+            rebuilt += graph.Update(solid, changed);
+        }
+        const double updateTime = yojimbo_time() - startedAt;
+
+        printf("[hpa] %dx%d: %zu clusters, %u portals, build %.2f ms, 1 tile changed %.3f ms (%.1f clusters rebuilt)\n",
+            size, size, graph.clusters.size(), graph.nodeCount, buildTime * 1000,
+            updateTime * 1000 / flipCount, (float)rebuilt / flipCount);
+        printf("[hpa]   anya %.0f us/query (found %d/%d), hpa + anya %.0f us/query (found %d/%d)\n",
+            anyaTime * 1e6 / queryCount, anyaFound, queryCount, hpaTime * 1e6 / queryCount, hpaFound, queryCount);
+
+        delete map;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "common.h"
+#include "anya.h"
+
+// Hierarchical pathfinding (HPA*) for long queries. The map is cut into clusters the size of a
+// tile chunk. Wherever two neighboring clusters are both open along their shared border there's
+// an entrance, with one or two portal tiles on each side of it. Each cluster knows the distance
+// between every pair of its portals, so a long search only has to walk portals, then Anya fills
+// in the path through each cluster along the way.
+//
+// NOTE(dlb): Distances are 8-way moves that don't cut corners, Anya's paths are any-angle, so the
+// portals we pick aren't always optimal. They're close enough for NPCs.
+
+#define HPA_CLUSTER_W         SV_MAX_TILE_CHUNK_WIDTH
+#define HPA_MAX_ENTRANCE_LEN  6    // entrances longer than this get a portal at each end instead of one in the middle
+#define HPA_REFINE_MAX_ITERS  1000  // Anya gets this many iterations per cluster before we walk it on the grid instead
+static_assert(HPA_CLUSTER_W <= 64, "cluster rows are one word");
+
+// Read-only view of padded solidity bits, laid out like Tilemap::solidBits (see SolidRow)
+struct Hpa_SolidView {
+    const uint64_t *bits   {};
+    uint32_t        stride {};  // uint64_t words per padded row
+    uint16_t        width  {};
+    uint16_t        height {};
+
+    inline bool IsSolid(int x, int y) const
+    {
+        if ((unsigned)x >= width || (unsigned)y >= height) {
+            return true;
+        }
+        const uint64_t *row = &bits[(size_t)(y + 1) * stride];
+        const uint32_t bit = (uint32_t)x + 1;
+        return (row[bit >> 6] >> (bit & 63)) & 1;
+    }
+    // 64 tiles of row y starting at tile x, bit i = tile x + i. Solid past the edge of the map.
+    uint64_t Row64(int x, int y) const;
+
+    static bool AnyaSolidQuery(int x, int y, void *userdata);
+};
+
+struct Hpa_Node {
+    uint16_t x, y;  // portal tile
+};
+
+struct Hpa_Cluster {
+    uint64_t              bits[HPA_CLUSTER_W]{};  // solidity it was built from, 1 word per row
+    std::vector<Hpa_Node> nodes {};
+    std::vector<float>    dist  {};  // nodes.size()^2 distances between portals, INFINITY if there's no way through
+};
+
+// Copies are cheap and can be searched on other threads, clusters are immutable once built and
+// shared between copies.
+struct Hpa_Graph {
+    uint16_t width     {};  // map size in tiles
+    uint16_t height    {};
+    uint16_t clustersW {};
+    uint16_t clustersH {};
+    std::vector<std::shared_ptr<const Hpa_Cluster>> clusters {};  // row-major
+    std::vector<uint32_t> nodeBase {};  // index of each cluster's first node, if they were all in one list
+    uint32_t nodeCount {};
+
+    // Rebuilds the clusters in changed (row-major indices, e.g. the tile chunks whose solidity
+    // changed since the last Update) that really did change, and the neighbors they share a
+    // changed border with. Builds every cluster the first time, or if the map changed size.
+    // Returns # of clusters rebuilt.
+    int Update(const Hpa_SolidView &solid, const std::vector<uint32_t> &changed);
+    // Portal tiles to pass through on the way from start to target (tile coords), including
+    // start and target. Returns false if there's no way there.
+    bool FindWaypoints(const Hpa_SolidView &solid, Vector2 start, Vector2 target, std::vector<Vector2> &waypoints) const;
+
+private:
+    inline uint32_t ClusterAt(int x, int y) const
+    {
+        return (uint32_t)(y / HPA_CLUSTER_W) * clustersW + x / HPA_CLUSTER_W;
+    }
+    int FindNode(uint32_t clusterIdx, int x, int y) const;  // local index of the portal at x,y, or -1
+    std::shared_ptr<const Hpa_Cluster> BuildCluster(const Hpa_SolidView &solid, int cx, int cy) const;
+};
+
+// FindWaypoints, then Anya from portal to portal within each cluster. path is in world coords,
+// like Anya_State::path. Returns false if there's no way there.
+bool Hpa_FindPath(const Hpa_Graph &graph, const Hpa_SolidView &solid, Vector2 start, Vector2 target, float radius, std::vector<Vector2> &path);
+
+void HpaBenchmark(void);
@@ -11,16 +11,224 @@ const char *MsgTypeStr(MsgType type)
         case MSG_S_CLOCK_SYNC:                    return "MSG_S_CLOCK_SYNC";
         case MSG_S_ENTITY_DESPAWN:                return "MSG_S_ENTITY_DESPAWN";
         case MSG_S_ENTITY_SAY:                    return "MSG_S_ENTITY_SAY";
-        case MSG_S_ENTITY_SNAPSHOT:               return "MSG_S_ENTITY_SNAPSHOT";
         case MSG_S_ENTITY_SPAWN:                  return "MSG_S_ENTITY_SPAWN";
         case MSG_S_TILE_CHUNK:                    return "MSG_S_TILE_CHUNK";
-        case MSG_S_TILE_UPDATE:                   return "MSG_S_TILE_UPDATE";
+        case MSG_S_TILE_DELTA:                    return "MSG_S_TILE_DELTA";
         case MSG_S_TITLE_SHOW:                    return "MSG_S_TITLE_SHOW";
+        case MSG_S_WORLD_SNAPSHOT:                return "MSG_S_WORLD_SNAPSHOT";
 
         default:                                  return "<UNKNOWN_MSG_TYPE>";
     }
 }
 
+Vector3 NetBounds::QuantizePosition(Vector3 position) const
+{
+    Vector3 quantized{};
+    quantized.x = QuantizeFloat(position.x, MinX(), MaxX(), SV_NET_POSITION_RES);
+    quantized.y = QuantizeFloat(position.y, MinY(), MaxY(), SV_NET_POSITION_RES);
+    if (position.z) {
+        quantized.z = QuantizeFloat(position.z, -SV_NET_POSITION_Z_MAX, SV_NET_POSITION_Z_MAX, SV_NET_POSITION_RES);
+    }
+    return quantized;
+}
+Vector3 NetBounds::QuantizeVelocity(Vector3 velocity) const
+{
+    Vector3 quantized{};
+    quantized.x = QuantizeFloat(velocity.x, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+    quantized.y = QuantizeFloat(velocity.y, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+    if (velocity.z) {
+        quantized.z = QuantizeFloat(velocity.z, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+    }
+    return quantized;
+}
+
+void EntityNetState::Quantize(const NetBounds &bounds)
+{
+    position = bounds.QuantizePosition(position);
+    velocity = bounds.QuantizeVelocity(velocity);
+}
+uint8_t EntityNetState::Diff(const EntityNetState &other) const
+{
+    uint8_t fields = 0;
+    if (type != other.type || spec != other.spec) {
+        fields |= FIELD_TYPE;
+    }
+    if (map_id != other.map_id) {
+        fields |= FIELD_MAP;
+    }
+    // NOTE(dlb): Exact compare on purpose, both ends need to agree bit-for-bit on the baseline
+    if (position.x != other.position.x || position.y != other.position.y || position.z != other.position.z) {
+        fields |= FIELD_POSITION;
+    }
+    if (velocity.x != other.velocity.x || velocity.y != other.velocity.y || velocity.z != other.velocity.z) {
+        fields |= FIELD_VELOCITY;
+    }
+    if (hp_max != other.hp_max || hp != other.hp) {
+        fields |= FIELD_LIFE;
+    }
+    if (on_warp_cooldown != other.on_warp_cooldown) {
+        fields |= FIELD_WARP;
+    }
+    return fields;
+}
+void EntityNetState::Apply(uint8_t fields, const EntityNetState &other)
+{
+    if (fields & FIELD_TYPE) {
+        type = other.type;
+        spec = other.spec;
+    }
+    if (fields & FIELD_MAP) {
+        map_id = other.map_id;
+    }
+    if (fields & FIELD_POSITION) {
+        position = other.position;
+    }
+    if (fields & FIELD_VELOCITY) {
+        velocity = other.velocity;
+    }
+    if (fields & FIELD_LIFE) {
+        hp_max = other.hp_max;
+        hp = other.hp;
+    }
+    if (fields & FIELD_WARP) {
+        on_warp_cooldown = other.on_warp_cooldown;
+    }
+}
+
+const EntityNetState *EntitySnapshotFrame::Find(uint32_t entity_id) const
+{
+    const auto entry = std::lower_bound(entities.begin(), entities.end(), entity_id,
+        [](const EntitySnapshotEntry &entry, uint32_t id) { return entry.entity_id < id; }
+    );
+    return entry != entities.end() && entry->entity_id == entity_id ? &entry->state : 0;
+}
+void EntitySnapshotFrame::Merge(const EntitySnapshotFrame *baseline, const EntitySnapshotRecord *records, size_t recordCount)
+{
+    assert(baseline != this);
+    entities.clear();
+    id_set_hash = 0;
+
+    const EntitySnapshotEntry *base = baseline ? baseline->entities.data() : 0;
+    const size_t baseCount = baseline ? baseline->entities.size() : 0;
+    size_t baseIdx = 0;
+    size_t recordIdx = 0;
+    while (baseIdx < baseCount || recordIdx < recordCount) {
+        if (recordIdx == recordCount || (baseIdx < baseCount && base[baseIdx].entity_id < records[recordIdx].entity_id)) {
+            entities.push_back(base[baseIdx++]);  // didn't change
+            continue;
+        }
+
+        const EntitySnapshotRecord &record = records[recordIdx++];
+        assert(recordIdx == recordCount || record.entity_id < records[recordIdx].entity_id);
+        EntitySnapshotEntry entry{ record.entity_id };
+        if (baseIdx < baseCount && base[baseIdx].entity_id == record.entity_id) {
+            entry.state = base[baseIdx++].state;
+        }
+        if (!record.removed) {
+            entry.state.Apply(record.fields, record.state);
+            entities.push_back(entry);
+        }
+    }
+
+    for (const EntitySnapshotEntry &entry : entities) {
+        id_set_hash += EntityIdHash(entry.entity_id);
+    }
+}
+EntitySnapshotFrame *FindSnapshotFrame(SnapshotHistory &history, uint32_t tick)
+{
+    if (!tick) {
+        return 0;
+    }
+    for (size_t i = 0; i < history.size(); i++) {
+        EntitySnapshotFrame &frame = history[i];
+        if (frame.tick == tick) {
+            return &frame;
+        }
+    }
+    return 0;
+}
+
+void NetTests(void)
+{
+    // Compressed floats: within bounds, round trip is within res/2 and quantizing is idempotent
+    {
+        const float min = -256.0f;
+        const float max = 6656.0f;
+        const float res = SV_NET_POSITION_RES;
+        for (int i = 0; i < 10000; i++) {
+            const float value = min + (max - min) * ((float)i / 9999.0f);
+            const float quantized = QuantizeFloat(value, min, max, res);
+            assert(fabsf(quantized - value) <= res * 0.5f);
+            assert(QuantizeFloat(quantized, min, max, res) == quantized);
+        }
+        assert(QuantizeFloat(min - 100.0f, min, max, res) == min);
+        assert(QuantizeFloat(max + 100.0f, min, max, res) == max);
+        assert(QuantizeFloat(0.0f, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES) == 0.0f);
+    }
+
+    // Records: what QuantizePosition/Velocity predict is exactly what the receiver decodes
+    {
+        const NetBounds bounds{ 100, 80 };
+        uint8_t buffer[256]{};
+
+        for (int i = 0; i < 1000; i++) {
+            EntitySnapshotRecord sent{};
+            sent.entity_id = 1 + i;
+            sent.fields = EntityNetState::FIELD_POSITION | EntityNetState::FIELD_VELOCITY;
+            sent.state.position.x = bounds.MinX() + (bounds.MaxX() - bounds.MinX()) * ((float)((i * 7919) % 1000) / 999.0f);
+            sent.state.position.y = bounds.MinY() + (bounds.MaxY() - bounds.MinY()) * ((float)((i * 104729) % 1000) / 999.0f);
+            sent.state.position.z = (i % 3) ? 0.0f : (float)(i % 200) * 1.37f;
+            sent.state.velocity.x = -SV_NET_VELOCITY_MAX + 2.0f * SV_NET_VELOCITY_MAX * ((float)((i * 31) % 1000) / 999.0f);
+            sent.state.velocity.y = (i % 2) ? 0.0f : -123.456f;
+            sent.state.velocity.z = (i % 5) ? 0.0f : 9.81f;
+
+            EntityNetState expected = sent.state;
+            expected.Quantize(bounds);
+
+            yojimbo::WriteStream writer{ yojimbo::GetDefaultAllocator(), buffer, sizeof(buffer) };
+            bool ok = sent.Serialize(writer, bounds);
+            assert(ok);
+            writer.Flush();
+
+            EntitySnapshotRecord recv{};
+            yojimbo::ReadStream reader{ yojimbo::GetDefaultAllocator(), buffer, sizeof(buffer) };
+            ok = recv.Serialize(reader, bounds);
+            assert(ok);
+
+            assert(recv.entity_id == sent.entity_id);
+            assert(recv.fields == sent.fields);
+            assert(!recv.state.Diff(expected));
+            assert(fabsf(recv.state.position.x - sent.state.position.x) <= SV_NET_POSITION_RES * 0.5f);
+            assert(fabsf(recv.state.position.y - sent.state.position.y) <= SV_NET_POSITION_RES * 0.5f);
+            assert(fabsf(recv.state.position.z - sent.state.position.z) <= SV_NET_POSITION_RES * 0.5f);
+            assert(fabsf(recv.state.velocity.x - sent.state.velocity.x) <= SV_NET_VELOCITY_RES * 0.5f);
+            assert(fabsf(recv.state.velocity.y - sent.state.velocity.y) <= SV_NET_VELOCITY_RES * 0.5f);
+            assert(fabsf(recv.state.velocity.z - sent.state.velocity.z) <= SV_NET_VELOCITY_RES * 0.5f);
+            assert((recv.state.position.z == 0) == (sent.state.position.z == 0));
+
+            // Re-encoding the decoded value must not change it (delta baselines depend on this)
+            EntityNetState requantized = recv.state;
+            requantized.Quantize(bounds);
+            assert(!requantized.Diff(recv.state));
+        }
+    }
+
+    // Size: a moving entity on the ground should be well under half of what raw floats cost
+    {
+        const NetBounds bounds{ 100, 100 };
+        EntitySnapshotRecord record{};
+        record.entity_id = 42;
+        record.fields = EntityNetState::FIELD_POSITION | EntityNetState::FIELD_VELOCITY;
+        record.state.position = { 1234.5f, 2345.25f, 0 };
+        record.state.velocity = { -300.0f, 150.0f, 0 };
+
+        yojimbo::MeasureStream measure{ yojimbo::GetDefaultAllocator() };
+        record.Serialize(measure, bounds);
+        const int rawBits = 32 + 1 + EntityNetState::FIELD_BITS + 6 * 32;
+        assert(measure.GetBitsProcessed() * 2 < rawBits);
+    }
+}
+
 void InitClientServerConfig(yojimbo::ClientServerConfig &config)
 {
     //config.maxPacketSize = 20000;
@@ -29,6 +237,8 @@ void InitClientServerConfig(yojimbo::ClientServerConfig &config)
     config.numChannels = CHANNEL_COUNT;
     config.channel[CHANNEL_U_INPUT_COMMANDS].type = yojimbo::CHANNEL_TYPE_UNRELIABLE_UNORDERED;
     config.channel[CHANNEL_U_ENTITY_SNAPSHOT].type = yojimbo::CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    // NOTE(dlb): Unreliable channels send blocks inline, so this has to fit in a packet
+    config.channel[CHANNEL_U_ENTITY_SNAPSHOT].maxBlockSize = SV_SNAPSHOT_BUDGET_BYTES;
 
     config.channel[CHANNEL_R_CLOCK_SYNC].type = yojimbo::CHANNEL_TYPE_RELIABLE_ORDERED;
     config.channel[CHANNEL_R_ENTITY_EVENT].type = yojimbo::CHANNEL_TYPE_RELIABLE_ORDERED;
@@ -27,11 +27,11 @@ enum MsgType
     MSG_S_CLOCK_SYNC,
     MSG_S_ENTITY_DESPAWN,
     MSG_S_ENTITY_SAY,
-    MSG_S_ENTITY_SNAPSHOT,
     MSG_S_ENTITY_SPAWN,
     MSG_S_TILE_CHUNK,
-    MSG_S_TILE_UPDATE,
+    MSG_S_TILE_DELTA,
     MSG_S_TITLE_SHOW,
+    MSG_S_WORLD_SNAPSHOT,
 
     MSG_COUNT
 };
@@ -70,10 +70,12 @@ struct Msg_C_EntityInteractDialogOption : public yojimbo::Message
 
 struct Msg_C_InputCommands : public yojimbo::Message
 {
+    uint32_t last_snapshot_acked{};  // newest snapshot tick the client has received in full
     RingBuffer<InputCmd, CL_SEND_INPUT_COUNT> cmdQueue{};
 
     template <typename Stream> bool Serialize(Stream &stream)
     {
+        serialize_uint32(stream, last_snapshot_acked);
         for (int i = 0; i < CL_SEND_INPUT_COUNT; i++) {
             InputCmd &cmd = cmdQueue[i];
             serialize_uint8(stream, cmd.seq);
@@ -177,65 +179,273 @@ struct Msg_S_EntitySay : public yojimbo::Message
     YOJIMBO_VIRTUAL_SERIALIZE_FUNCTIONS();
 };
 
-struct Msg_S_EntitySnapshot : public yojimbo::Message
+// Bounded, quantized floats. Values are clamped to [min, max] and rounded to the nearest
+// multiple of res (relative to min), then sent as an integer using only as many bits as that
+// range needs. With res a power of 2 and min a multiple of it, every quantized value is exactly
+// representable, so QuantizeFloat() gives the same bits the receiver will decode.
+inline int CompressedFloatBits(float min, float max, float res)
 {
-    double server_time {};
+    return yojimbo::bits_required(0, (uint32_t)ceilf((max - min) / res));
+}
+inline uint32_t CompressFloat(float value, float min, float max, float res)
+{
+    const float clamped = CLAMP(value, min, max);
+    return (uint32_t)floorf((clamped - min) / res + 0.5f);
+}
+inline float DecompressFloat(uint32_t integer, float min, float res)
+{
+    return min + (float)integer * res;
+}
+inline float QuantizeFloat(float value, float min, float max, float res)
+{
+    return DecompressFloat(CompressFloat(value, min, max, res), min, res);
+}
+
+template <typename Stream> bool serialize_compressed_float_internal(Stream &stream, float &value, float min, float max, float res)
+{
+    const int bits = CompressedFloatBits(min, max, res);
+    uint32_t integer = 0;
+    if (Stream::IsWriting) {
+        integer = CompressFloat(value, min, max, res);
+    }
+    if (!stream.SerializeBits(integer, bits)) {
+        return false;
+    }
+    if (Stream::IsReading) {
+        value = DecompressFloat(integer, min, res);
+    }
+    return true;
+}
+
+#define serialize_compressed_float( stream, value, min, max, res )                         \
+    do {                                                                                    \
+        if (!serialize_compressed_float_internal(stream, value, min, max, res)) {          \
+            return false;                                                                   \
+        }                                                                                   \
+    } while (0)
+
+// Range that positions and velocities are quantized to on the wire. Position bounds are derived
+// from the size of the maps (the client may not know a map's size yet when it receives entities
+// that are on it), so they're sent along with the msgs that use them.
+struct NetBounds {
+    uint16_t world_w {};  // width of the largest map, in tiles
+    uint16_t world_h {};  // height of the largest map, in tiles
+
+    NetBounds(void) = default;
+    NetBounds(uint16_t world_w, uint16_t world_h) : world_w(world_w), world_h(world_h) {}
+
+    float MinX(void) const { return -(float)SV_NET_POSITION_MARGIN; }
+    float MinY(void) const { return -(float)SV_NET_POSITION_MARGIN; }
+    float MaxX(void) const { return (float)(world_w * TILE_W + SV_NET_POSITION_MARGIN); }
+    float MaxY(void) const { return (float)(world_h * TILE_W + SV_NET_POSITION_MARGIN); }
+
+    Vector3 QuantizePosition(Vector3 position) const;
+    Vector3 QuantizeVelocity(Vector3 velocity) const;
+
+    template <typename Stream> bool Serialize(Stream &stream)
+    {
+        serialize_varint32(stream, world_w);
+        serialize_varint32(stream, world_h);
+        return true;
+    }
+
+    // z is usually 0 (only things in the air have height), so it costs 1 bit when it is
+    template <typename Stream> bool SerializePosition(Stream &stream, Vector3 &position) const
+    {
+        serialize_compressed_float(stream, position.x, MinX(), MaxX(), SV_NET_POSITION_RES);
+        serialize_compressed_float(stream, position.y, MinY(), MaxY(), SV_NET_POSITION_RES);
+        bool has_z = Stream::IsWriting && position.z != 0;
+        serialize_bool(stream, has_z);
+        if (has_z) {
+            serialize_compressed_float(stream, position.z, -SV_NET_POSITION_Z_MAX, SV_NET_POSITION_Z_MAX, SV_NET_POSITION_RES);
+        } else if (Stream::IsReading) {
+            position.z = 0;
+        }
+        return true;
+    }
+
+    template <typename Stream> bool SerializeVelocity(Stream &stream, Vector3 &velocity) const
+    {
+        serialize_compressed_float(stream, velocity.x, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+        serialize_compressed_float(stream, velocity.y, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+        bool has_z = Stream::IsWriting && velocity.z != 0;
+        serialize_bool(stream, has_z);
+        if (has_z) {
+            serialize_compressed_float(stream, velocity.z, -SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_MAX, SV_NET_VELOCITY_RES);
+        } else if (Stream::IsReading) {
+            velocity.z = 0;
+        }
+        return true;
+    }
+};
+
+#define serialize_position( stream, bounds, value )       \
+    do {                                                  \
+        if (!(bounds).SerializePosition(stream, value)) { \
+            return false;                                 \
+        }                                                 \
+    } while (0)
+
+#define serialize_velocity( stream, bounds, value )       \
+    do {                                                  \
+        if (!(bounds).SerializeVelocity(stream, value)) { \
+            return false;                                 \
+        }                                                 \
+    } while (0)
+
+void NetTests(void);
+
+// The networked subset of an entity's state. Entity snapshots are delta-encoded against the
+// last snapshot the client acknowledged, so both ends keep a history of these per snapshot.
+struct EntityNetState {
+    enum Field : uint8_t {
+        FIELD_TYPE     = 0x01,  // type, spec (only sent when there's no baseline)
+        FIELD_MAP      = 0x02,
+        FIELD_POSITION = 0x04,
+        FIELD_VELOCITY = 0x08,
+        FIELD_LIFE     = 0x10,  // hp_max, hp
+        FIELD_WARP     = 0x20,  // on_warp_cooldown
+        FIELD_ALL      = 0x3F,
+        FIELD_BITS     = 6
+    };
 
     // Entity
-    uint32_t        entity_id  {};
-    Entity::Type    type       {};  // doesn't change, but needed for switch statements in deserializer
-    Entity::Species spec       {};
-    uint16_t        map_id     {};
-    Vector3         position   {};
+    Entity::Type    type             {};
+    Entity::Species spec             {};
+    uint16_t        map_id           {};
+    Vector3         position         {};
     bool            on_warp_cooldown {};
 
     // Collision
-    //float       radius     {};  // when would this ever change? doesn't.. for now.
+    //float         radius           {};  // when would this ever change? doesn't.. for now.
 
     // Life
-    int           hp_max  {};
-    int           hp      {};
+    int             hp_max           {};
+    int             hp               {};
 
     // Physics
-    //float       speed      {};  // we don't need to know speed for ghosts
-    Vector3       velocity   {};
+    //float         speed            {};  // we don't need to know speed for ghosts
+    Vector3         velocity         {};
 
-    // Only sent to the player who owns this player entity.
-    uint8_t       last_processed_input_cmd {};
+    void Quantize(const NetBounds &bounds);  // rounds to what the client will decode, see NetBounds
+    uint8_t Diff(const EntityNetState &other) const;  // returns mask of fields that differ
+    void Apply(uint8_t fields, const EntityNetState &other);  // copies the masked fields from other
+};
 
-    template <typename Stream> bool Serialize(Stream &stream)
+// Order-independent hash of a set of entity ids: sum EntityIdHash() of each member
+inline uint64_t EntityIdHash(uint32_t entity_id)
+{
+    uint64_t z = entity_id + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+struct EntitySnapshotRecord;
+
+struct EntitySnapshotEntry {
+    uint32_t       entity_id {};
+    EntityNetState state     {};
+};
+
+// Entity state as of a particular snapshot tick, from one client's point of view
+struct EntitySnapshotFrame {
+    uint32_t tick        {};  // 0 = unused
+    bool     complete    {};  // (server only) every change made it under the snapshot budget, i.e. this is exactly the world state (of the relevant entities) as of tick
+    uint64_t id_set_hash {};  // hash of the ids in entities, see EntityIdHash
+    std::vector<EntitySnapshotEntry> entities{};  // sorted by entity_id
+
+    const EntityNetState *Find(uint32_t entity_id) const;
+    // entities = baseline's (none if null) with records applied on top, records must be sorted by
+    // entity_id. Reuses entities' memory, so frames that get reused don't allocate.
+    void Merge(const EntitySnapshotFrame *baseline, const EntitySnapshotRecord *records, size_t recordCount);
+};
+typedef RingBuffer<EntitySnapshotFrame, SV_SNAPSHOT_HISTORY> SnapshotHistory;
+
+EntitySnapshotFrame *FindSnapshotFrame(SnapshotHistory &history, uint32_t tick);
+
+// One entity's delta within a world snapshot. These are packed back-to-back into the snapshot's
+// block, rather than being yojimbo messages, so they don't each pay for a message header.
+struct EntitySnapshotRecord
+{
+    uint32_t       entity_id {};
+    bool           removed   {};  // entity is no longer in the snapshot (e.g. despawned)
+    uint8_t        fields    {};  // EntityNetState::Field mask of which fields of state are present
+    EntityNetState state     {};
+
+    template <typename Stream> bool Serialize(Stream &stream, const NetBounds &bounds)
     {
-        serialize_double(stream, server_time);
+        serialize_varint32(stream, entity_id);
+        serialize_bool(stream, removed);
+        if (removed) {
+            return true;
+        }
+        serialize_bits(stream, fields, EntityNetState::FIELD_BITS);
 
-        // Entity
-        serialize_uint32(stream, entity_id);
-        serialize_uint8(stream, (uint8_t &)type);
-        serialize_uint8(stream, (uint8_t &)spec);
-        serialize_uint16(stream, map_id);
-        serialize_float(stream, position.x);
-        serialize_float(stream, position.y);
-        serialize_float(stream, position.z);
+        if (fields & EntityNetState::FIELD_TYPE) {
+            serialize_uint8(stream, (uint8_t &)state.type);
+            serialize_uint8(stream, (uint8_t &)state.spec);
+        }
+        if (fields & EntityNetState::FIELD_MAP) {
+            serialize_uint16(stream, state.map_id);
+        }
+        if (fields & EntityNetState::FIELD_POSITION) {
+            serialize_position(stream, bounds, state.position);
+        }
 
         // Physics
-        serialize_float(stream, velocity.x);
-        serialize_float(stream, velocity.y);
-        serialize_float(stream, velocity.z);
+        if (fields & EntityNetState::FIELD_VELOCITY) {
+            serialize_velocity(stream, bounds, state.velocity);
+        }
 
         // Life
-        if (type == Entity::TYP_PLAYER || type == Entity::TYP_NPC) {
-            serialize_varint32(stream, hp_max);
-            if (hp_max) {
-                serialize_varint32(stream, hp);
+        if (fields & EntityNetState::FIELD_LIFE) {
+            serialize_varint32(stream, state.hp_max);
+            if (state.hp_max) {
+                serialize_varint32(stream, state.hp);
             }
         }
 
-        if (type == Entity::TYP_PLAYER) {
-            serialize_bool(stream, on_warp_cooldown);
-            serialize_uint8(stream, last_processed_input_cmd);
+        if (fields & EntityNetState::FIELD_WARP) {
+            serialize_bool(stream, state.on_warp_cooldown);
         }
 
         return true;
     }
+};
+
+// Everything that changed in the world since the client's baseline, as of one server tick. The
+// entity records live in the block (see EntitySnapshotRecord) so the server can serialize them
+// once and hand the same bytes to every client that has the same baseline.
+struct Msg_S_WorldSnapshot : public yojimbo::BlockMessage
+{
+    double   server_time   {};
+    uint32_t tick          {};  // server tick this snapshot was taken on
+    uint32_t baseline_tick {};  // snapshot this msg is a delta against, 0 = none (all fields are sent)
+    uint32_t entity_count  {};  // # of EntitySnapshotRecords packed into the block
+    NetBounds bounds       {};  // what the records' positions/velocities are quantized to
+
+    // Sequence number of the last input command processed for the receiving player's entity
+    uint8_t  last_processed_input_cmd {};
+
+    template <typename Stream> bool Serialize(Stream &stream)
+    {
+        serialize_double(stream, server_time);
+        serialize_uint32(stream, tick);
+        uint32_t baseline_age = 0;
+        if (Stream::IsWriting && baseline_tick) {
+            assert(tick - baseline_tick <= SV_SNAPSHOT_MAX_BASELINE_AGE);
+            baseline_age = tick - baseline_tick;
+        }
+        serialize_int(stream, baseline_age, 0, SV_SNAPSHOT_MAX_BASELINE_AGE);
+        if (Stream::IsReading) {
+            baseline_tick = baseline_age ? tick - baseline_age : 0;
+        }
+        serialize_varint32(stream, entity_count);
+        serialize_object(stream, bounds);
+        serialize_uint8(stream, last_processed_input_cmd);
+        return true;
+    }
 
     YOJIMBO_VIRTUAL_SERIALIZE_FUNCTIONS();
 };
@@ -250,6 +460,7 @@ struct Msg_S_EntitySpawn : public yojimbo::Message
     Entity::Species spec        {};
     char            name        [SV_MAX_ENTITY_NAME_LEN + 1]{};
     uint16_t        map_id      {};
+    NetBounds       bounds      {};  // what position/velocity are quantized to
     Vector3         position    {};
     // Collision
     float           radius      {};
@@ -276,9 +487,8 @@ struct Msg_S_EntitySpawn : public yojimbo::Message
         serialize_uint8(stream, (uint8_t&)spec);
         serialize_string(stream, name, sizeof(name));
         serialize_uint16(stream, map_id);
-        serialize_float(stream, position.x);
-        serialize_float(stream, position.y);
-        serialize_float(stream, position.z);
+        serialize_object(stream, bounds);
+        serialize_position(stream, bounds, position);
 
         // Collision
         serialize_float(stream, radius);
@@ -292,9 +502,7 @@ struct Msg_S_EntitySpawn : public yojimbo::Message
         // Physics
         serialize_float(stream, drag);
         serialize_float(stream, speed);
-        serialize_float(stream, velocity.x);
-        serialize_float(stream, velocity.y);
-        serialize_float(stream, velocity.z);
+        serialize_velocity(stream, bounds, velocity);
 
         // Sprite
         serialize_uint32(stream, sprite_id);
@@ -339,21 +547,24 @@ struct Msg_S_TileChunk : public yojimbo::BlockMessage
     YOJIMBO_VIRTUAL_SERIALIZE_FUNCTIONS();
 };
 
-struct Msg_S_TileUpdate : public yojimbo::Message
+// Tiles changed in one chunk since the last snapshot. Block is run_count (start, count) uint16_t
+// pairs of chunk tile indices (x + y * TileChunk::WIDTH), followed by the new tile ids of every
+// tile in those runs, one layer after another.
+struct Msg_S_TileDelta : public yojimbo::BlockMessage
 {
-    uint16_t map_id    {};
-    uint16_t x         {};
-    uint16_t y         {};
-    uint16_t tile_ids  [TILE_LAYER_COUNT]{};
+    uint16_t map_id     {};
+    uint16_t x          {};  // chunk's top-left tile
+    uint16_t y          {};
+    uint16_t tile_count {};  // # of changed tiles
+    uint16_t run_count  {};  // # of runs of consecutive changed tiles
 
     template <typename Stream> bool Serialize(Stream &stream)
     {
         serialize_uint16(stream, map_id);
         serialize_uint16(stream, x);
         serialize_uint16(stream, y);
-        for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-            serialize_uint16(stream, tile_ids[layer]);
-        }
+        serialize_uint16(stream, tile_count);
+        serialize_uint16(stream, run_count);
         return true;
     }
 
@@ -383,11 +594,11 @@ YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_C_TILE_INTERACT,                 Msg_C_TileInte
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_CLOCK_SYNC,                    Msg_S_ClockSync);
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_ENTITY_DESPAWN,                Msg_S_EntityDespawn);
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_ENTITY_SAY,                    Msg_S_EntitySay);
-YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_ENTITY_SNAPSHOT,               Msg_S_EntitySnapshot);
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_ENTITY_SPAWN,                  Msg_S_EntitySpawn);
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_TILE_CHUNK,                    Msg_S_TileChunk);
-YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_TILE_UPDATE,                   Msg_S_TileUpdate);
+YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_TILE_DELTA,                    Msg_S_TileDelta);
 YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_TITLE_SHOW,                    Msg_S_TitleShow);
+YOJIMBO_DECLARE_MESSAGE_TYPE(MSG_S_WORLD_SNAPSHOT,                Msg_S_WorldSnapshot);
 YOJIMBO_MESSAGE_FACTORY_FINISH();
 
 class NetAdapter : public yojimbo::Adapter
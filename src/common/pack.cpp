@@ -316,12 +316,22 @@ void Process(PackStream &stream, AiPath &aiPath)
 void Process(PackStream &stream, Tilemap &tile_map)
 {
     if (stream.mode == PackStreamMode::PACK_MODE_WRITE) {
+        tile_map.ChunksToLayers();
         for (auto &layer : tile_map.layers) {
             assert(layer.size() == tile_map.width * tile_map.height);
         }
     }
 
     HAQ_IO(HQT_TILE_MAP_FIELDS, tile_map);
+
+    if (stream.mode == PackStreamMode::PACK_MODE_READ) {
+        tile_map.LayersToChunks();
+    } else {
+        for (auto &layer : tile_map.layers) {
+            layer.clear();
+            layer.shrink_to_fit();
+        }
+    }
 }
 void Process(PackStream &stream, Entity &entity)
 {
@@ -331,11 +341,15 @@ void Process(PackStream &stream, Entity &entity)
         return;
     }
 
+    if (!entity.cold) {
+        entity.cold = &stream.pack->entity_cold.emplace_back();
+    }
+
     //// Entity ////
     PROC(entity.id);
     PROC(entity.type);
     PROC(entity.spec);
-    PROC(entity.name);
+    PROC(entity.cold->name);
     PROC(entity.caused_by);
     PROC(entity.spawned_at);
     //PROC(entity.despawned_at);
@@ -343,9 +357,9 @@ void Process(PackStream &stream, Entity &entity)
     PROC(entity.map_id);
     PROC(entity.position);
 
-    PROC(entity.ambient_fx);
-    PROC(entity.ambient_fx_delay_min);
-    PROC(entity.ambient_fx_delay_max);
+    PROC(entity.cold->ambient_fx);
+    PROC(entity.cold->ambient_fx_delay_min);
+    PROC(entity.cold->ambient_fx_delay_max);
 
     PROC(entity.radius);
     //PROC(entity.colliding);
@@ -354,11 +368,11 @@ void Process(PackStream &stream, Entity &entity)
     //PROC(entity.last_attacked_at);
     //PROC(entity.attack_cooldown);
 
-    PROC(entity.dialog_root_key);
+    PROC(entity.cold->dialog_root_key);
     //PROC(entity.dialog_spawned_at);
     //PROC(entity.dialog_id);
-    //PROC(entity.dialog_title);
-    //PROC(entity.dialog_message);
+    //PROC(entity.cold->dialog_title);
+    //PROC(entity.cold->dialog_message);
 
     PROC(entity.hp_max);
     PROC(entity.hp);
@@ -387,7 +401,7 @@ void Process(PackStream &stream, Entity &entity)
 
     PROC(entity.warp_dest_map);
     PROC(entity.warp_template_map);
-    PROC(entity.warp_template_tileset);
+    PROC(entity.cold->warp_template_tileset);
 }
 
 template <typename T>
@@ -695,7 +709,7 @@ Err LoadPack(Pack &pack, PackStreamType type, std::string path)
     }
     return err;
 }
-Err LoadResources(Pack &pack)
+Err LoadResources(Pack &pack, bool loadMedia)
 {
     Err err = RN_SUCCESS;
 
@@ -724,7 +738,7 @@ Err LoadResources(Pack &pack)
     }
 #endif
 
-    {
+    if (loadMedia) {
         PerfTimer t{ "Load graphics" };
         for (GfxFile &gfx_file : pack.gfx_files) {
             if (gfx_file.path.empty()) continue;
@@ -732,14 +746,14 @@ Err LoadResources(Pack &pack)
             SetTextureFilter(gfx_file.texture, TEXTURE_FILTER_POINT);
         }
     }
-    {
+    if (loadMedia) {
         PerfTimer t{ "Load music" };
         for (MusFile &mus_file : pack.mus_files) {
             if (mus_file.path.empty()) continue;
             mus_file.music = LoadMusicStream(mus_file.path.c_str());
         }
     }
-    {
+    if (loadMedia) {
         PerfTimer t{ "Load sounds" };
         for (SfxFile &sfx_file : pack.sfx_files) {
             if (sfx_file.path.empty()) continue;
@@ -757,48 +771,50 @@ Err LoadResources(Pack &pack)
                 LoadSoundVariant(sfx_file, sfx_file.path.c_str());
             }
         }
+    }
 
 #if _DEBUG
-        // HACK(dlb): auto-generate ids for newly added frames
-        uint16_t next_frame_id = 0;
-        for (GfxFrame &gfx_frame : pack.gfx_frames) {
-            if (gfx_frame.id < UINT16_MAX) {
-                next_frame_id = MAX(next_frame_id, gfx_frame.id + 1);
-            }
+    // HACK(dlb): auto-generate ids for newly added frames
+    uint16_t next_frame_id = 0;
+    for (GfxFrame &gfx_frame : pack.gfx_frames) {
+        if (gfx_frame.id < UINT16_MAX) {
+            next_frame_id = MAX(next_frame_id, gfx_frame.id + 1);
         }
-        for (GfxFrame &gfx_frame : pack.gfx_frames) {
-            if (gfx_frame.id == UINT16_MAX) {
-                gfx_frame.id = next_frame_id++;
-            }
-            if (!gfx_frame.name.size()) {
-                gfx_frame.name = TextFormat("frm_%s_%u_%u", gfx_frame.gfx.c_str(), gfx_frame.x, gfx_frame.y);
-            }
+    }
+    for (GfxFrame &gfx_frame : pack.gfx_frames) {
+        if (gfx_frame.id == UINT16_MAX) {
+            gfx_frame.id = next_frame_id++;
+        }
+        if (!gfx_frame.name.size()) {
+            gfx_frame.name = TextFormat("frm_%s_%u_%u", gfx_frame.gfx.c_str(), gfx_frame.x, gfx_frame.y);
         }
+    }
 
-        // HACK(dlb): auto-generate ids for newly added anims
-        uint16_t next_anim_id = 0;
-        for (GfxAnim &gfx_anim : pack.gfx_anims) {
-            if (gfx_anim.id < UINT16_MAX) {
-                next_anim_id = MAX(next_anim_id, gfx_anim.id + 1);
-            }
+    // HACK(dlb): auto-generate ids for newly added anims
+    uint16_t next_anim_id = 0;
+    for (GfxAnim &gfx_anim : pack.gfx_anims) {
+        if (gfx_anim.id < UINT16_MAX) {
+            next_anim_id = MAX(next_anim_id, gfx_anim.id + 1);
         }
-        for (GfxAnim &gfx_anim : pack.gfx_anims) {
-            if (gfx_anim.id == UINT16_MAX) {
-                gfx_anim.id = next_anim_id++;
-            }
-            if (!gfx_anim.name.size()) {
-                gfx_anim.name = TextFormat("anim_%s_%u_%u", gfx_anim.frames[0].c_str());
-            }
+    }
+    for (GfxAnim &gfx_anim : pack.gfx_anims) {
+        if (gfx_anim.id == UINT16_MAX) {
+            gfx_anim.id = next_anim_id++;
+        }
+        if (!gfx_anim.name.size()) {
+            gfx_anim.name = TextFormat("anim_%s_%u_%u", gfx_anim.frames[0].c_str());
         }
-#endif
     }
+#endif
 
     return err;
 }
 void UnloadPack(Pack &pack)
 {
     for (GfxFile &gfxFile : pack.gfx_files) {
-        UnloadTexture(gfxFile.texture);
+        if (gfxFile.texture.id) {
+            UnloadTexture(gfxFile.texture);
+        }
     }
     for (MusFile &musFile : pack.mus_files) {
         UnloadMusicStream(musFile.music);
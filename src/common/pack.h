@@ -68,6 +68,7 @@ struct Pack {
     // - particles? maybe?
     std::vector<Tilemap> tile_maps{};
     std::vector<Entity> entities{};
+    std::deque<EntityCold> entity_cold{};  // EntityDB has its own, these are just for the ones in the pack
 
     std::unordered_map<uint16_t, size_t> dat_by_id[DAT_TYP_COUNT]{};
     std::unordered_map<std::string, size_t> dat_by_name[DAT_TYP_COUNT]{};
@@ -101,6 +102,17 @@ struct Pack {
         }
     }
 
+    template <typename T>
+    static const std::string &DatName(T &dat)
+    {
+        return dat.name;
+    }
+    static const std::string &DatName(Entity &entity)
+    {
+        static const std::string noName{};
+        return entity.cold ? entity.cold->name : noName;
+    }
+
     template <typename T>
     bool AddToIndex(T &dat, size_t index)
     {
@@ -111,8 +123,9 @@ struct Pack {
         }
 
         auto &by_name = dat_by_name[T::dtype];
-        if (dat.name.size() && by_name.find(dat.name) != by_name.end()) {
-            TraceLog(LOG_ERROR, "pack already contains type %s with name '%s'", DataTypeStr(T::dtype), dat.name.c_str());
+        const std::string &name = DatName(dat);
+        if (name.size() && by_name.find(name) != by_name.end()) {
+            TraceLog(LOG_ERROR, "pack already contains type %s with name '%s'", DataTypeStr(T::dtype), name.c_str());
             return false;
         }
 
@@ -127,7 +140,7 @@ struct Pack {
         }
 
         by_id[dat.id] = index;
-        by_name[dat.name] = index;
+        by_name[name] = index;
         return true;
     }
 
@@ -224,5 +237,5 @@ struct PackStream {
 
 Err SavePack(Pack &pack, PackStreamType type, std::string path = "");
 Err LoadPack(Pack &pack, PackStreamType type, std::string path = "");
-Err LoadResources(Pack &pack);
+Err LoadResources(Pack &pack, bool loadMedia = true);  // loadMedia = false skips textures, music, and sounds
 void UnloadPack(Pack &pack);
\ No newline at end of file
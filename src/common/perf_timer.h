@@ -9,7 +9,7 @@ struct PerfTimer {
 
     PerfTimer(const std::string &name) : name(name) {
         timerStack.push_back(this);
-        startedAt = GetTime();
+        startedAt = yojimbo_time();
         char buf[256]{};
         int len = 0;
         for (const PerfTimer *timer : timerStack) {
@@ -22,7 +22,7 @@ struct PerfTimer {
     }
 
     ~PerfTimer(void) {
-        double endedAt = GetTime();
+        double endedAt = yojimbo_time();
         char buf[256]{};
         int len = 0;
         for (const PerfTimer *timer : timerStack) {
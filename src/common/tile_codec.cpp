@@ -0,0 +1,244 @@
+#include "tile_codec.h"
+#include "data.h"
+
+static void WriteVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+static bool ReadVarint(const uint8_t *&cursor, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (cursor == end) {
+            return false;
+        }
+        const uint8_t byte = *cursor++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileCodec::Encode(const TileChunk &chunk, uint16_t w, uint16_t h, std::vector<uint8_t> &out)
+{
+    assert(w <= TileChunk::WIDTH);
+    assert(h <= TileChunk::WIDTH);
+
+    if (paletteIdx.empty()) {
+        paletteIdx.resize(UINT16_MAX + 1);
+    }
+    palette.clear();
+    indices.resize((size_t)TILE_LAYER_COUNT * w * h);
+
+    uint16_t *index = indices.data();
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint16_t ty = 0; ty < h; ty++) {
+            const uint16_t *row = &chunk.layers[layer][ty * TileChunk::WIDTH];
+            for (uint16_t tx = 0; tx < w; tx++) {
+                uint16_t &slot = paletteIdx[row[tx]];
+                if (!slot) {
+                    palette.push_back(row[tx]);
+                    slot = (uint16_t)palette.size();
+                }
+                *index++ = slot - 1;
+            }
+        }
+    }
+    for (uint16_t tile_id : palette) {
+        paletteIdx[tile_id] = 0;
+    }
+
+    WriteVarint(out, (uint32_t)palette.size());
+    for (uint16_t tile_id : palette) {
+        WriteVarint(out, tile_id);
+    }
+
+    // XOR with the row above only if it makes for fewer runs. It does for vertical stripes, but
+    // for autotiled maps it mostly just breaks up the repeats LZ4 would've found anyway.
+    int runsNone = 0;
+    int runsUp = 0;
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint16_t ty = 1; ty < h; ty++) {
+            const uint16_t *row = &indices[((size_t)layer * h + ty) * w];
+            for (uint16_t tx = 1; tx < w; tx++) {
+                runsNone += row[tx] != row[tx - 1];
+                runsUp += (row[tx] ^ row[tx - w]) != (row[tx - 1] ^ row[tx - 1 - w]);
+            }
+        }
+    }
+    const bool xorUp = runsUp < runsNone;
+    out.push_back(xorUp);
+
+    const bool wide = palette.size() > 256;
+    const size_t indicesStart = out.size();
+    out.resize(indicesStart + indices.size() * (wide ? 2 : 1));
+    uint8_t *cursor = &out[indicesStart];
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint16_t ty = 0; ty < h; ty++) {
+            const uint16_t *row = &indices[((size_t)layer * h + ty) * w];
+            for (uint16_t tx = 0; tx < w; tx++) {
+                const uint16_t value = xorUp && ty ? row[tx] ^ row[tx - w] : row[tx];
+                if (wide) {
+                    cursor[0] = (uint8_t)value;
+                    cursor[1] = (uint8_t)(value >> 8);
+                    cursor += 2;
+                } else {
+                    *cursor++ = (uint8_t)value;
+                }
+            }
+        }
+    }
+}
+bool TileCodec::Decode(const uint8_t *data, size_t size, uint16_t w, uint16_t h, uint16_t *tile_ids)
+{
+    const uint8_t *cursor = data;
+    const uint8_t *end = data + size;
+    const size_t tileCount = (size_t)TILE_LAYER_COUNT * w * h;
+
+    uint32_t paletteCount = 0;
+    if (!ReadVarint(cursor, end, paletteCount) || !paletteCount || paletteCount > tileCount) {
+        return false;
+    }
+    palette.resize(paletteCount);
+    for (uint32_t i = 0; i < paletteCount; i++) {
+        uint32_t tile_id = 0;
+        if (!ReadVarint(cursor, end, tile_id) || tile_id > UINT16_MAX) {
+            return false;
+        }
+        palette[i] = (uint16_t)tile_id;
+    }
+
+    if (cursor == end || *cursor > 1) {
+        return false;
+    }
+    const bool xorUp = *cursor++;
+
+    const bool wide = paletteCount > 256;
+    if ((size_t)(end - cursor) != tileCount * (wide ? 2 : 1)) {
+        return false;
+    }
+
+    // Undo the XOR in place, the row above is already palette indices again by the time we get
+    // to each row
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint16_t ty = 0; ty < h; ty++) {
+            uint16_t *row = &tile_ids[((size_t)layer * h + ty) * w];
+            for (uint16_t tx = 0; tx < w; tx++) {
+                uint16_t value = 0;
+                if (wide) {
+                    value = (uint16_t)(cursor[0] | (cursor[1] << 8));
+                    cursor += 2;
+                } else {
+                    value = *cursor++;
+                }
+                row[tx] = xorUp && ty ? value ^ row[tx - w] : value;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < tileCount; i++) {
+        if (tile_ids[i] >= paletteCount) {
+            return false;
+        }
+        tile_ids[i] = palette[tile_ids[i]];
+    }
+    return true;
+}
+
+void TileCodecBenchmark(void)
+{
+    TileCodec codec{};
+    std::vector<uint16_t> raw{};
+    std::vector<uint8_t> encoded{};
+    std::vector<uint8_t> smol{};
+    std::vector<uint16_t> decoded{};
+
+    struct Chunk {
+        const TileChunk *chunk;
+        uint16_t w, h;
+    };
+    std::vector<Chunk> chunks{};
+    for (Tilemap &map : pack_maps.tile_maps) {
+        for (uint16_t y = 0; y < map.height; y += TileChunk::WIDTH) {
+            for (uint16_t x = 0; x < map.width; x += TileChunk::WIDTH) {
+                chunks.push_back({ &map.ChunkAt(x, y), (uint16_t)MIN(map.width - x, TileChunk::WIDTH), (uint16_t)MIN(map.height - y, TileChunk::WIDTH) });
+            }
+        }
+    }
+    if (chunks.empty()) {
+        printf("[tile_codec] benchmark skipped, no maps loaded\n");
+        return;
+    }
+
+    // Compressed size, old format (raw tile ids) vs. codec
+    size_t rawBytes = 0;
+    size_t rawSmolBytes = 0;
+    size_t encodedBytes = 0;
+    size_t encodedSmolBytes = 0;
+    for (const Chunk &c : chunks) {
+        raw.clear();
+        for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+            for (uint16_t ty = 0; ty < c.h; ty++) {
+                const uint16_t *row = &c.chunk->layers[layer][ty * TileChunk::WIDTH];
+                raw.insert(raw.end(), row, row + c.w);
+            }
+        }
+        const int raw_size = raw.size() * sizeof(raw[0]);
+        smol.resize(LZ4_compressBound(raw_size));
+        rawBytes += raw_size;
+        rawSmolBytes += LZ4_compress_default((char *)raw.data(), (char *)smol.data(), raw_size, smol.size());
+
+        encoded.clear();
+        codec.Encode(*c.chunk, c.w, c.h, encoded);
+        smol.resize(LZ4_compressBound(encoded.size()));
+        const int smol_size = LZ4_compress_default((char *)encoded.data(), (char *)smol.data(), encoded.size(), smol.size());
+        encodedBytes += encoded.size();
+        encodedSmolBytes += smol_size;
+
+        decoded.resize(raw.size());
+        const bool ok = codec.Decode(encoded.data(), encoded.size(), c.w, c.h, decoded.data());
+        assert(ok);
+        assert(decoded == raw);
+    }
+    printf("[tile_codec] %zu chunks, %zu bytes of tiles\n", chunks.size(), rawBytes);
+    printf("[tile_codec] raw + lz4:   %zu bytes\n", rawSmolBytes);
+    printf("[tile_codec] codec:       %zu bytes\n", encodedBytes);
+    printf("[tile_codec] codec + lz4: %zu bytes\n", encodedSmolBytes);
+
+    // Throughput, the way the server and client do it (codec + lz4)
+    const int iterations = 1000;
+    double startedAt = yojimbo_time();
+    for (int i = 0; i < iterations; i++) {
+        const Chunk &c = chunks[i % chunks.size()];
+        encoded.clear();
+        codec.Encode(*c.chunk, c.w, c.h, encoded);
+        smol.resize(LZ4_compressBound(encoded.size()));
+        const int smol_size = LZ4_compress_default((char *)encoded.data(), (char *)smol.data(), encoded.size(), smol.size());
+        smol.resize(smol_size);
+    }
+    double elapsed = yojimbo_time() - startedAt;
+    size_t tileBytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        const Chunk &c = chunks[i % chunks.size()];
+        tileBytes += (size_t)TILE_LAYER_COUNT * c.w * c.h * sizeof(uint16_t);
+    }
+    printf("[tile_codec] encode: %.1f MB/s\n", tileBytes / elapsed / 1e6);
+
+    // Decode the last chunk over and over, there's only one compressed payload handy
+    const Chunk &last = chunks[(iterations - 1) % chunks.size()];
+    decoded.resize((size_t)TILE_LAYER_COUNT * last.w * last.h);
+    startedAt = yojimbo_time();
+    for (int i = 0; i < iterations; i++) {
+        const int encoded_size = LZ4_decompress_safe((char *)smol.data(), (char *)encoded.data(), smol.size(), encoded.size());
+        const bool ok = codec.Decode(encoded.data(), encoded_size, last.w, last.h, decoded.data());
+        assert(ok);
+    }
+    elapsed = yojimbo_time() - startedAt;
+    printf("[tile_codec] decode: %.1f MB/s\n", decoded.size() * sizeof(decoded[0]) * iterations / elapsed / 1e6);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "common.h"
+#include "tilemap.h"
+
+// Tile chunk wire format, compressed with LZ4 afterwards. Chunks only use a handful of distinct
+// tiles, so they're sent as 1 byte palette indices instead of 2 byte tile ids:
+//
+//   varint  palette_count
+//   varint  palette[palette_count]    distinct tile ids in the chunk, in order of first appearance
+//   uint8_t xor_up                    1 = each row is XOR'd with the row above it (except the first
+//                                     row of each layer)
+//   indices[TILE_LAYER_COUNT][h][w]   palette indices, uint8_t if palette_count <= 256, otherwise
+//                                     little-endian uint16_t
+struct TileCodec {
+    // Appends the w x h top-left corner of the chunk to out
+    void Encode(const TileChunk &chunk, uint16_t w, uint16_t h, std::vector<uint8_t> &out);
+    // Decodes into tile_ids[TILE_LAYER_COUNT][h][w], returns false if data is malformed
+    bool Decode(const uint8_t *data, size_t size, uint16_t w, uint16_t h, uint16_t *tile_ids);
+
+private:
+    std::vector<uint16_t> paletteIdx{};  // tile id -> palette index + 1, 0 = not in palette (reset after each Encode)
+    std::vector<uint16_t> palette{};
+    std::vector<uint16_t> indices{};  // Encode scratch
+};
+
+void TileCodecBenchmark(void);
@@ -5,11 +5,118 @@
 #include "wang.h"
 #include "flood_fill.h"
 
+void Tilemap::Resize(uint16_t new_width, uint16_t new_height)
+{
+    const uint16_t newChunksW = (new_width + TileChunk::WIDTH - 1) / TileChunk::WIDTH;
+    const uint16_t newChunksH = (new_height + TileChunk::WIDTH - 1) / TileChunk::WIDTH;
+
+    // Tiles keep their chunk when the map is resized, only the chunk grid changes shape
+    std::vector<TileChunk> newChunks((size_t)newChunksW * newChunksH);
+    for (uint16_t cy = 0; cy < newChunksH && cy < chunksH; cy++) {
+        for (uint16_t cx = 0; cx < newChunksW && cx < chunksW; cx++) {
+            newChunks[(size_t)cy * newChunksW + cx] = chunks[(size_t)cy * chunksW + cx];
+        }
+    }
+
+    // Clear tiles that fell off the edge of the partial chunks on the right/bottom, so they don't
+    // come back if the map grows again
+    for (uint16_t cy = 0; cy < newChunksH; cy++) {
+        for (uint16_t cx = 0; cx < newChunksW; cx++) {
+            TileChunk &chunk = newChunks[(size_t)cy * newChunksW + cx];
+            const uint16_t chunkW = (uint16_t)MIN(TileChunk::WIDTH, new_width - cx * TileChunk::WIDTH);
+            const uint16_t chunkH = (uint16_t)MIN(TileChunk::WIDTH, new_height - cy * TileChunk::WIDTH);
+            if (chunkW == TileChunk::WIDTH && chunkH == TileChunk::WIDTH) {
+                continue;
+            }
+            for (uint16_t ty = 0; ty < TileChunk::WIDTH; ty++) {
+                for (uint16_t tx = ty < chunkH ? chunkW : 0; tx < TileChunk::WIDTH; tx++) {
+                    const uint32_t chunkTileIdx = ty * TileChunk::WIDTH + tx;
+                    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+                        chunk.layers[layer][chunkTileIdx] = 0;
+                    }
+                    chunk.dirty[chunkTileIdx / 64] &= ~(1ull << (chunkTileIdx % 64));
+                }
+            }
+            chunk.version++;
+            chunk.anyDirty = false;
+            for (uint64_t word : chunk.dirty) {
+                chunk.anyDirty |= word != 0;
+            }
+        }
+    }
+
+    chunks.swap(newChunks);
+    chunksW = newChunksW;
+    chunksH = newChunksH;
+    width = new_width;
+    height = new_height;
+
+    dirtyChunks.clear();
+    for (uint32_t chunkIdx = 0; chunkIdx < chunks.size(); chunkIdx++) {
+        if (chunks[chunkIdx].anyDirty) {
+            dirtyChunks.push_back(chunkIdx);
+        }
+    }
+
+    // Tiles came and went along the edges, and anything that cached solidity (flow fields,
+    // PathService) has to notice the map changed size
+    InvalidateSolidity();
+}
+void Tilemap::LayersToChunks(void)
+{
+    chunks.clear();
+    chunksW = 0;
+    chunksH = 0;
+    Resize(width, height);
+
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        if (layers[layer].size() != (size_t)width * height) {
+            assert(!"layer size doesn't match map size");
+            continue;
+        }
+        for (uint16_t y = 0; y < height; y++) {
+            for (uint16_t x = 0; x < width; x++) {
+                TileChunk &chunk = ChunkAt(x, y);
+                chunk.layers[layer][TileChunk::TileIndex(x, y)] = layers[layer][(size_t)y * width + x];
+            }
+        }
+        layers[layer].clear();
+        layers[layer].shrink_to_fit();
+    }
+
+    InvalidateSolidity();
+}
+void Tilemap::ChunksToLayers(void)
+{
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        layers[layer].resize((size_t)width * height);
+        for (uint16_t y = 0; y < height; y++) {
+            for (uint16_t x = 0; x < width; x++) {
+                layers[layer][(size_t)y * width + x] = At((TileLayerType)layer, x, y);
+            }
+        }
+    }
+}
+TileChunk &Tilemap::ChunkAt(uint16_t x, uint16_t y)
+{
+    const size_t chunkIdx = (size_t)(y / TileChunk::WIDTH) * chunksW + x / TileChunk::WIDTH;
+    assert(chunkIdx < chunks.size());
+    return chunks[chunkIdx];
+}
+void Tilemap::ClearDirtyTiles(void)
+{
+    for (uint32_t chunkIdx : dirtyChunks) {
+        TileChunk &chunk = chunks[chunkIdx];
+        memset(chunk.dirty, 0, sizeof(chunk.dirty));
+        chunk.anyDirty = false;
+    }
+    dirtyChunks.clear();
+}
 uint16_t Tilemap::At(TileLayerType layer, uint16_t x, uint16_t y)
 {
     assert(x < width);
     assert(y < height);
-    return layers[layer][(size_t)y * width + x];
+    return ChunkAt(x, y).layers[layer][TileChunk::TileIndex(x, y)];
 }
 bool Tilemap::AtTry(TileLayerType layer, int x, int y, uint16_t &tile_id)
 {
@@ -37,14 +144,10 @@ bool Tilemap::AtWorld(TileLayerType layer, int world_x, int world_y, uint16_t &t
     }
     return false;
 }
-bool Tilemap::IsSolid(int x, int y)
+bool Tilemap::ComputeSolid(uint16_t x, uint16_t y)
 {
     for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-        uint16_t tile_id = 0;
-        if (!AtTry((TileLayerType)layer, x, y, tile_id)) {
-            // Out of bounds tiles are considered solid tiles
-            return true;
-        }
+        const uint16_t tile_id = At((TileLayerType)layer, x, y);
 
         // NOTE(dlb): Don't collide with void tiles above ground level (it just means there's no object)
         if (layer > 0 && !tile_id) {
@@ -58,11 +161,31 @@ bool Tilemap::IsSolid(int x, int y)
     }
     return false;
 }
+void Tilemap::UpdateSolidBits(void)
+{
+    solidBitsWidth = width;
+    solidBitsHeight = height;
+    solidBitsStride = ((uint32_t)width + 2 + 63) / 64;
+
+    // Start with everything solid so the padding ring and the unused high bits of each row read
+    // as out of bounds, then clear the open tiles.
+    solidBits.assign((size_t)solidBitsStride * ((size_t)height + 2), ~0ull);
+    for (uint16_t y = 0; y < height; y++) {
+        uint64_t *row = &solidBits[(size_t)(y + 1) * solidBitsStride];
+        for (uint16_t x = 0; x < width; x++) {
+            if (!ComputeSolid(x, y)) {
+                const uint32_t bit = (uint32_t)x + 1;
+                row[bit >> 6] &= ~(1ull << (bit & 63));
+            }
+        }
+    }
+
+    solidBitsDirty = false;
+    edgesDirtyAll = true;
+}
 
 void Tilemap::Autotile(TileLayerType layer, uint16_t x, uint16_t y, double now)
 {
-    enum AutoDir { NW, N, NE, W, E, SW, S, SE };
-
     uint16_t center_tile_id = 0;
     if (!AtTry(layer, x, y, center_tile_id)) {
         return;
@@ -124,42 +247,66 @@ void Tilemap::Autotile(TileLayerType layer, uint16_t x, uint16_t y, double now)
     if (match[6]) center_mask |= auto_masks[6];
     if (match[7]) center_mask |= auto_masks[7];
 
-    TileDef *new_tile = FindTileDefByMask(center_def.auto_tile_group, center_mask);
-    if (new_tile) {
-        Set(layer, x, y, new_tile->id, now, false);
-        return;
+    // NOTE(dlb): Falls back to partial matches when there's no exact match (see BuildAutoTileLut)
+    const uint16_t new_tile_id = FindAutoTile(center_def.auto_tile_group, center_mask);
+    if (new_tile_id) {
+        Set(layer, x, y, new_tile_id, now, false);
     }
-
-    // Check for a partial match by ignoring corners that aren't fully connected (via both adjacent edges)
-    if (!(match[N] && match[W])) center_mask &= ~auto_masks[NW];
-    if (!(match[N] && match[E])) center_mask &= ~auto_masks[NE];
-    if (!(match[S] && match[W])) center_mask &= ~auto_masks[SW];
-    if (!(match[S] && match[E])) center_mask &= ~auto_masks[SE];
-
-    new_tile = FindTileDefByMask(center_def.auto_tile_group, center_mask);
-    if (new_tile) {
-        Set(layer, x, y, new_tile->id, now, false);
-        return;
+}
+void Tilemap::AutotileRegion(TileLayerType layer, const Region &region, double now)
+{
+    const int x0 = MAX(region.tl.x - 1, 0);
+    const int y0 = MAX(region.tl.y - 1, 0);
+    const int x1 = MIN(region.br.x + 1, width - 1);
+    const int y1 = MIN(region.br.y + 1, height - 1);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            Autotile(layer, x, y, now);
+        }
     }
-
-    // Check for a partial by ignoring all corners
-    new_tile = FindTileDefByMask(center_def.auto_tile_group, center_mask & ~auto_masks[NW] & ~auto_masks[NE] & ~auto_masks[SW] & ~auto_masks[SE]);
-    if (new_tile) {
-        Set(layer, x, y, new_tile->id, now, false);
-        return;
+}
+void Tilemap::AutotileChanged(TileLayerType layer, const std::vector<Coord> &changed, double now)
+{
+    // Mark the 3x3 around every changed tile, then autotile each marked tile once
+    const size_t stride = ((size_t)width + 63) / 64;
+    autotileScratch.assign(stride * height, 0);
+    for (const Coord &coord : changed) {
+        for (int y = MAX(coord.y - 1, 0); y <= MIN(coord.y + 1, height - 1); y++) {
+            for (int x = MAX(coord.x - 1, 0); x <= MIN(coord.x + 1, width - 1); x++) {
+                autotileScratch[y * stride + x / 64] |= 1ull << (x % 64);
+            }
+        }
+    }
+    for (uint16_t y = 0; y < height; y++) {
+        for (size_t word = 0; word < stride; word++) {
+            uint64_t bits = autotileScratch[y * stride + word];
+            while (bits) {
+                const uint16_t x = (uint16_t)(word * 64 + std::countr_zero(bits));
+                Autotile(layer, x, y, now);
+                bits &= bits - 1;
+            }
+        }
     }
 }
 void Tilemap::Set(TileLayerType layer, uint16_t x, uint16_t y, uint16_t tile_id, double now, bool autotile)
 {
     assert(x < width);
     assert(y < height);
-    uint16_t &cur_tile_id = layers[layer][(size_t)y * width + x];
+    TileChunk &chunk = ChunkAt(x, y);
+    const uint32_t chunkTileIdx = TileChunk::TileIndex(x, y);
+    uint16_t &cur_tile_id = chunk.layers[layer][chunkTileIdx];
     if (cur_tile_id != tile_id) {
         cur_tile_id = tile_id;
 
-        // TODO: Don't do this on client, expensive, waste of time
-        dirtyTiles.insert({ x, y });
-        chunkLastUpdatedAt = now;
+        if (!chunk.anyDirty) {
+            chunk.anyDirty = true;
+            chunk.cleanVersion = chunk.version;
+            dirtyChunks.push_back((uint32_t)(&chunk - chunks.data()));
+        }
+        chunk.version++;
+        chunk.dirty[chunkTileIdx / 64] |= 1ull << (chunkTileIdx % 64);
+
+        UpdateSolid(x, y);
     }
 
     if (autotile) {
@@ -175,6 +322,48 @@ void Tilemap::Set(TileLayerType layer, uint16_t x, uint16_t y, uint16_t tile_id,
         Autotile(layer, x + 1, y + 1, now);
     }
 }
+void Tilemap::SetChunkTiles(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *tile_ids)
+{
+    assert(x + w <= width);
+    assert(y + h <= height);
+    assert(w && h);
+    assert(x / TileChunk::WIDTH == (x + w - 1) / TileChunk::WIDTH);
+    assert(y / TileChunk::WIDTH == (y + h - 1) / TileChunk::WIDTH);
+
+    TileChunk &chunk = ChunkAt(x, y);
+    bool changed = false;
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint16_t ty = 0; ty < h; ty++) {
+            const uint32_t chunkTileIdx = TileChunk::TileIndex(x, y + ty);
+            const uint16_t *src = &tile_ids[((size_t)layer * h + ty) * w];
+            uint16_t *dst = &chunk.layers[layer][chunkTileIdx];
+            if (!memcmp(dst, src, w * sizeof(*dst))) {
+                continue;
+            }
+            memcpy(dst, src, w * sizeof(*dst));
+            for (uint32_t i = chunkTileIdx; i < chunkTileIdx + w; i++) {
+                chunk.dirty[i / 64] |= 1ull << (i % 64);
+            }
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+
+    if (!chunk.anyDirty) {
+        chunk.anyDirty = true;
+        chunk.cleanVersion = chunk.version;
+        dirtyChunks.push_back((uint32_t)(&chunk - chunks.data()));
+    }
+    chunk.version++;
+
+    for (uint16_t ty = 0; ty < h; ty++) {
+        for (uint16_t tx = 0; tx < w; tx++) {
+            UpdateSolid(x + tx, y + ty);
+        }
+    }
+}
 bool Tilemap::SetTry(TileLayerType layer, uint16_t x, uint16_t y, uint16_t tile_id, double now, bool autotile)
 {
     if (x >= 0 && y >= 0 && x < width && y < height) {
@@ -191,19 +380,22 @@ void Tilemap::SetFromWangMap(WangMap &wangMap, double now)
     }
 
     uint8_t *pixels = (uint8_t *)wangMap.image.data;
-    for (uint16_t y = 0; y < width; y++) {
-        for (uint16_t x = 0; x < height; x++) {
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
             uint8_t tile = pixels[y * width + x];
             tile = tile < (width * height) ? tile : 0;
-            Set(TILE_LAYER_GROUND, x, y, tile, now);
+            Set(TILE_LAYER_GROUND, x, y, tile, now, false);
         }
     }
+
+    AutotileRegion(TILE_LAYER_GROUND, { { 0, 0 }, { width - 1, height - 1 } }, now);
 }
 
 struct TileFloodData {
     Tilemap *map;
     TileLayerType layer;
     double now;
+    std::vector<Tilemap::Coord> changed;
 };
 
 bool TileFlood_TryGet(int x, int y, void *userdata, int *value)
@@ -220,7 +412,8 @@ bool TileFlood_TryGet(int x, int y, void *userdata, int *value)
 void TileFlood_Set(int x, int y, int value, void *userdata)
 {
     TileFloodData *data = (TileFloodData *)userdata;
-    data->map->Set(data->layer, x, y, value, data->now);
+    data->map->Set(data->layer, x, y, value, data->now, false);
+    data->changed.push_back({ x, y });
 }
 
 void Tilemap::Flood(TileLayerType layer, uint16_t x, uint16_t y, uint16_t new_tile_id, double now)
@@ -231,6 +424,10 @@ void Tilemap::Flood(TileLayerType layer, uint16_t x, uint16_t y, uint16_t new_ti
     data.now = now;
     FloodFill filler{ TileFlood_TryGet, TileFlood_Set, (void *)&data };
     filler.Fill(x, y, new_tile_id);
+
+    // NOTE(dlb): Autotile after the fill, otherwise auto-tiling the edges of the fill as we go
+    // changes the tiles the fill is still comparing against
+    AutotileChanged(layer, data.changed, now);
 }
 
 bool TileFloodDebug_TryGet(int x, int y, void *userdata, int *value)
@@ -256,8 +453,13 @@ Tilemap::TileFloodDebugData Tilemap::FloodDebug(TileLayerType layer, uint16_t x,
     TileFloodDebugData data{};
     data.map_w = width;
     data.map_h = height;
-    data.tile_ids_before = layers[layer];
-    data.tile_ids_after = layers[layer];
+    data.tile_ids_before.resize((size_t)width * height);
+    for (uint16_t ty = 0; ty < height; ty++) {
+        for (uint16_t tx = 0; tx < width; tx++) {
+            data.tile_ids_before[(size_t)ty * width + tx] = At(layer, tx, ty);
+        }
+    }
+    data.tile_ids_after = data.tile_ids_before;
     FloodFill filler{ TileFloodDebug_TryGet, TileFloodDebug_Set, (void *)&data };
     filler.Fill(x, y, new_tile_id);
 
@@ -347,72 +549,197 @@ void Tilemap::UpdatePower(double now)
         }
     }
 }
-void Tilemap::UpdateEdges(void)
+void Tilemap::UpdateSolid(uint16_t x, uint16_t y)
 {
-    //PerfTimer t{ "UpdateEdges" };
-    edges.clear();
+    // NOTE(dlb): Skip the solidity check when the bitmap gets rebuilt anyway (e.g. receiving
+    // the first chunk on the client, which sets every tile).
+    if (!solidBitsDirty && solidBitsWidth == width && solidBitsHeight == height) {
+        const bool solid = ComputeSolid(x, y);
+        if (solid != IsSolid(x, y)) {
+            uint64_t *row = &solidBits[(size_t)(y + 1) * solidBitsStride];
+            const uint32_t bit = (uint32_t)x + 1;
+            row[bit >> 6] ^= 1ull << (bit & 63);
+            solidVersion++;
+            ChunkAt(x, y).solidVersion = solidVersion;
+            MarkEdgesDirty(x, y);
+        }
+    }
+}
+void Tilemap::InvalidateSolidity(void)
+{
+    solidBitsDirty = true;
+    solidVersion++;
+    edgesDirtyAll = true;
+    for (TileChunk &chunk : chunks) {
+        chunk.solidVersion = solidVersion;
+    }
+}
+void Tilemap::MarkEdgesDirty(uint16_t x, uint16_t y)
+{
+    if (edgeRowsDirty.size() != (size_t)height + 1 || edgeColsDirty.size() != (size_t)width + 1) {
+        // Map was resized since the last rebuild
+        edgesDirtyAll = true;
+        return;
+    }
+
+    // A tile touches the row boundaries above/below it and the column boundaries left/right of it
+    edgeRowsDirty[y] = true;
+    edgeRowsDirty[y + 1] = true;
+    edgeColsDirty[x] = true;
+    edgeColsDirty[x + 1] = true;
+    edgesDirty = true;
+}
+// Walks the runs of bits set in (solid & ~other) across a pair of padded solidity rows
+struct EdgeRunIter {
+    const uint64_t *solid;
+    const uint64_t *other;
+    uint32_t words;
+    uint32_t word{};
+    int pos{};
+
+    EdgeRunIter(const uint64_t *solid, const uint64_t *other, uint32_t words)
+        : solid(solid), other(other), words(words) {}
+
+    // [start, end) in padded bit coords, i.e. tile x + 1
+    bool Next(int &start, int &end)
+    {
+        start = -1;
+        while (word < words) {
+            const uint64_t mask = solid[word] & ~other[word];
+            // Looking for the start of a run (set bit) or the end of one (clear bit)
+            const uint64_t bits = (start < 0 ? mask : ~mask) & (~0ull << pos);
+            if (!bits) {
+                word++;
+                pos = 0;
+                continue;
+            }
+            pos = std::countr_zero(bits);
+            if (start < 0) {
+                start = (int)word * 64 + pos;
+            } else {
+                end = (int)word * 64 + pos;
+                return true;
+            }
+        }
+        // NOTE(dlb): Padding bits are solid in both rows, so every run ends before the last word does
+        assert(start < 0);
+        return false;
+    }
+};
+
+void Tilemap::UpdateEdgeRow(int y)
+{
+    Edge::Array &rowEdges = edgeRows[y];
+    rowEdges.clear();
 
     // Clockwise winding, Edge Normal = (-y, x)
 
+    // 64 tiles at a time: top edges are solid below the boundary and open above, bottom edges the
+    // other way around. Emitted in order of where each run ends, same as a tile-by-tile scan.
+    const uint64_t *row = SolidRow(y);
+    const uint64_t *rowAbove = SolidRow(y - 1);
+    EdgeRunIter tops{ row, rowAbove, solidBitsStride };
+    EdgeRunIter bottoms{ rowAbove, row, solidBitsStride };
+
+    int topStart = 0, topEnd = 0;
+    int bottomStart = 0, bottomEnd = 0;
+    bool hasTop = tops.Next(topStart, topEnd);
+    bool hasBottom = bottoms.Next(bottomStart, bottomEnd);
+
+    while (hasTop || hasBottom) {
+        if (hasTop && (!hasBottom || topEnd < bottomEnd)) {
+            const Vector2 left { (float)(topStart - 1) * TILE_W, (float)y * TILE_W };
+            const Vector2 right{ (float)(topEnd   - 1) * TILE_W, (float)y * TILE_W };
+            rowEdges.push_back(Edge{{ left, right }});
+            hasTop = tops.Next(topStart, topEnd);
+        } else {
+            const Vector2 left { (float)(bottomStart - 1) * TILE_W, (float)y * TILE_W };
+            const Vector2 right{ (float)(bottomEnd   - 1) * TILE_W, (float)y * TILE_W };
+            rowEdges.push_back(Edge{{ right, left }});
+            hasBottom = bottoms.Next(bottomStart, bottomEnd);
+        }
+    }
+}
+void Tilemap::UpdateEdgeCol(int x)
+{
+    Edge::Array &colEdges = edgeCols[x];
+    colEdges.clear();
+
+    int leftStartIdx = -1;
+    int rightStartIdx = -1;
+
     for (int y = 0; y <= height; y++) {
-        int topStartIdx = -1;
-        int bottomStartIdx = -1;
-
-        for (int x = 0; x <= width; x++) {
-            const bool solid = IsSolid(x, y);
-            const bool solidAbove = IsSolid(x, y - 1);
-
-            const bool isTopEdge = solid && !solidAbove;
-            if (topStartIdx == -1 && isTopEdge) {
-                topStartIdx = x;
-            } else if (topStartIdx != -1 && (!isTopEdge || x == width )) {
-                const Vector2 left { (float)topStartIdx * TILE_W, (float)y * TILE_W };
-                const Vector2 right{ (float)x           * TILE_W, (float)y * TILE_W };
-                edges.push_back(Edge{{ left, right }});
-                topStartIdx = -1;
-            }
+        const bool solid = IsSolid(x, y);
+        const bool solidLeft = IsSolid(x - 1, y);
+
+        const bool isLeftEdge = solid && !solidLeft;
+        if (leftStartIdx == -1 && isLeftEdge) {
+            leftStartIdx = y;
+        } else if (leftStartIdx != -1 && (!isLeftEdge || y == height )) {
+            const Vector2 top   { (float)x * TILE_W, (float)leftStartIdx * TILE_W };
+            const Vector2 bottom{ (float)x * TILE_W, (float)y            * TILE_W };
+            colEdges.push_back(Edge{{ bottom, top }});
+            leftStartIdx = -1;
+        }
 
-            const bool isBottomEdge = !solid && solidAbove;
-            if (bottomStartIdx == -1 && isBottomEdge) {
-                bottomStartIdx = x;
-            } else if (bottomStartIdx != -1 && (!isBottomEdge || x == width )) {
-                const Vector2 left { (float)bottomStartIdx * TILE_W, (float)y * TILE_W };
-                const Vector2 right{ (float)x              * TILE_W, (float)y * TILE_W };
-                edges.push_back(Edge{{ right, left }});
-                bottomStartIdx = -1;
-            }
+        const bool isRightEdge = !solid && solidLeft;
+        if (rightStartIdx == -1 && isRightEdge) {
+            rightStartIdx = y;
+        } else if (rightStartIdx != -1 && (!isRightEdge || y == height )) {
+            const Vector2 top   { (float)x * TILE_W, (float)rightStartIdx * TILE_W };
+            const Vector2 bottom{ (float)x * TILE_W, (float)y             * TILE_W };
+            colEdges.push_back(Edge{{ top, bottom }});
+            rightStartIdx = -1;
         }
     }
-    
-    for (int x = 0; x <= width; x++) {
-        int leftStartIdx = -1;
-        int rightStartIdx = -1;
-
-        for (int y = 0; y <= height; y++) {
-            const bool solid = IsSolid(x, y);
-            const bool solidLeft = IsSolid(x - 1, y);
-
-            const bool isLeftEdge = solid && !solidLeft;
-            if (leftStartIdx == -1 && isLeftEdge) {
-                leftStartIdx = y;
-            } else if (leftStartIdx != -1 && (!isLeftEdge || y == height )) {
-                const Vector2 top   { (float)x * TILE_W, (float)leftStartIdx * TILE_W };
-                const Vector2 bottom{ (float)x * TILE_W, (float)y            * TILE_W };
-                edges.push_back(Edge{{ bottom, top }});
-                leftStartIdx = -1;
-            }
+}
+bool Tilemap::UpdateEdges(void)
+{
+    //PerfTimer t{ "UpdateEdges" };
+    SolidRow(0);  // rebuild solidity bitmap first if it's stale, which may dirty all edges
+    if (edgeRows.size() != (size_t)height + 1 || edgeCols.size() != (size_t)width + 1) {
+        edgesDirtyAll = true;
+    }
 
-            const bool isRightEdge = !solid && solidLeft;
-            if (rightStartIdx == -1 && isRightEdge) {
-                rightStartIdx = y;
-            } else if (rightStartIdx != -1 && (!isRightEdge || y == height )) {
-                const Vector2 top   { (float)x * TILE_W, (float)rightStartIdx * TILE_W };
-                const Vector2 bottom{ (float)x * TILE_W, (float)y             * TILE_W };
-                edges.push_back(Edge{{ top, bottom }});
-                rightStartIdx = -1;
-            }
+    if (edgesDirtyAll) {
+        edgeRows.resize((size_t)height + 1);
+        edgeCols.resize((size_t)width + 1);
+        edgeRowsDirty.assign((size_t)height + 1, true);
+        edgeColsDirty.assign((size_t)width + 1, true);
+        edgesDirtyAll = false;
+        edgesDirty = true;
+    }
+
+    if (!edgesDirty) {
+        return false;
+    }
+
+    // NOTE(dlb): Edges only merge along their own row/column boundary, so a solidity change at
+    // tile (x, y) can only affect row boundaries y, y + 1 and column boundaries x, x + 1.
+    for (int y = 0; y <= height; y++) {
+        if (edgeRowsDirty[y]) {
+            UpdateEdgeRow(y);
+            edgeRowsDirty[y] = false;
+        }
+    }
+    for (int x = 0; x <= width; x++) {
+        if (edgeColsDirty[x]) {
+            UpdateEdgeCol(x);
+            edgeColsDirty[x] = false;
         }
     }
+
+    // Flatten into the edge list that collision and the editor iterate (same order as a full rebuild)
+    edges.clear();
+    for (const Edge::Array &rowEdges : edgeRows) {
+        edges.insert(edges.end(), rowEdges.begin(), rowEdges.end());
+    }
+    for (const Edge::Array &colEdges : edgeCols) {
+        edges.insert(edges.end(), colEdges.begin(), colEdges.end());
+    }
+
+    edgesDirty = false;
+    return true;
 }
 void Tilemap::UpdateIntervals(void)
 {
@@ -420,6 +747,31 @@ void Tilemap::UpdateIntervals(void)
 
     // TODO(cleanup): UpdatePathfinding() somewhere
 }
+const FlowField &Tilemap::FlowTo(uint32_t key, Coord goal, uint16_t radius, double now)
+{
+    assert(goal.x >= 0 && goal.x < width && goal.y >= 0 && goal.y < height);
+
+    FlowField *field = 0;
+    for (FlowField &existing : flowFields) {
+        if (existing.key == key) {
+            field = &existing;
+            break;
+        }
+    }
+    if (!field) {
+        field = &flowFields.emplace_back();
+        field->key = key;
+    }
+
+    field->lastUsedAt = now;
+    if (field->steps.empty() || field->goal_x != goal.x || field->goal_y != goal.y ||
+        field->radius != radius || field->solidVersion != solidVersion)
+    {
+        field->radius = radius;
+        field->Compute(*this, (uint16_t)goal.x, (uint16_t)goal.y);
+    }
+    return *field;
+}
 void Tilemap::Update(double now, bool simulate)
 {
     //Tilemap *map = LocalPlayerMap();
@@ -429,12 +781,23 @@ void Tilemap::Update(double now, bool simulate)
         UpdatePower(now);
     }
 
-    // TODO: Only run this when the edge list is dirty
-    UpdateEdges();
-    UpdateIntervals();
+    if (chunksW != (width + TileChunk::WIDTH - 1) / TileChunk::WIDTH ||
+        chunksH != (height + TileChunk::WIDTH - 1) / TileChunk::WIDTH)
+    {
+        // Map size was edited directly (e.g. in the editor's pack viewer), re-layout the chunks
+        Resize(width, height);
+    }
+
+    if (UpdateEdges()) {
+        UpdateIntervals();
+    }
+
+    std::erase_if(flowFields, [now](const FlowField &field) {
+        return now - field.lastUsedAt > SV_FLOW_FIELD_TTL;
+    });
 }
 
-void Tilemap::ResolveEntityCollisionsEdges(Entity &entity)
+void Tilemap::ResolveEntityCollisionsEdges(Entity &entity, bool broadphase)
 {
     if (!entity.radius || entity.Dead()) {
         return;
@@ -442,8 +805,10 @@ void Tilemap::ResolveEntityCollisionsEdges(Entity &entity)
 
     entity.colliding = false;
 
-    std::vector<Collision> collisions{};
-    for (Edge &edge : edges) {
+    std::vector<Collision> &collisions = collisionScratch;
+    collisions.clear();
+
+    auto checkEdge = [&](Edge &edge) {
         Manifold manifold{};
         if (dlb_CheckCollisionCircleEdge(entity.Position2D(), entity.radius, edge, &manifold)) {
             if (Vector2DotProduct(manifold.normal, edge.normal) > 0) {
@@ -453,6 +818,46 @@ void Tilemap::ResolveEntityCollisionsEdges(Entity &entity)
                 collisions.push_back(collision);
             }
         }
+    };
+
+    if (broadphase) {
+        // NOTE(dlb): edgeRows/edgeCols double as the broadphase. Each boundary's edges are disjoint
+        // and sorted left to right (top to bottom), so we only visit the boundaries the circle's
+        // bounds cross and binary search within them. Padded a pixel to stay conservative.
+        // Visiting rows then columns keeps the same order as walking the flattened edge list.
+        const float pad = entity.radius + 1;
+        const float left   = entity.position.x - pad;
+        const float right  = entity.position.x + pad;
+        const float top    = entity.position.y - pad;
+        const float bottom = entity.position.y + pad;
+
+        const int minRow = MAX(0, (int)ceilf(top / TILE_W));
+        const int maxRow = MIN((int)edgeRows.size() - 1, (int)floorf(bottom / TILE_W));
+        for (int y = minRow; y <= maxRow; y++) {
+            Edge::Array &rowEdges = edgeRows[y];
+            auto edgeIt = std::lower_bound(rowEdges.begin(), rowEdges.end(), left, [](const Edge &edge, float x) {
+                return MAX(edge.line.start.x, edge.line.end.x) < x;
+            });
+            for (; edgeIt != rowEdges.end() && MIN(edgeIt->line.start.x, edgeIt->line.end.x) <= right; edgeIt++) {
+                checkEdge(*edgeIt);
+            }
+        }
+
+        const int minCol = MAX(0, (int)ceilf(left / TILE_W));
+        const int maxCol = MIN((int)edgeCols.size() - 1, (int)floorf(right / TILE_W));
+        for (int x = minCol; x <= maxCol; x++) {
+            Edge::Array &colEdges = edgeCols[x];
+            auto edgeIt = std::lower_bound(colEdges.begin(), colEdges.end(), top, [](const Edge &edge, float y) {
+                return MAX(edge.line.start.y, edge.line.end.y) < y;
+            });
+            for (; edgeIt != colEdges.end() && MIN(edgeIt->line.start.y, edgeIt->line.end.y) <= bottom; edgeIt++) {
+                checkEdge(*edgeIt);
+            }
+        }
+    } else {
+        for (Edge &edge : edges) {
+            checkEdge(edge);
+        }
     }
 
     if (collisions.size() > 1) {
@@ -651,10 +1056,17 @@ void Tilemap::DrawIntervals(Camera2D &camera)
     }
 
     const float radius = 8.0f;
-    Anya_State state{ start, target, Tilemap_AnyaSolidQuery, this };
+    Anya_State &state = Anya_ThreadState();
+    state.Reset(start, target, Tilemap_AnyaSolidQuery, this);
     Anya(state, radius);
-    
+
+#if SV_DBG_ANYA_SEARCH_ORDER
     const auto &nodes = showGeneratedNodes ? state.nodes : state.nodeSearchOrder;
+#else
+    // Search order isn't recorded in release builds
+    const auto &nodes = state.nodes;
+    showGeneratedNodes = true;
+#endif
     if (nodeLast) {
         nodeIdx = nodes.size() - 1;
     } else {
@@ -871,3 +1283,148 @@ void Tilemap::DrawFloodDebug(TileFloodDebugData &floodDebugData)
         DrawRectangleLinesEx(rect, 2.0f, rect_col);
     }
 }
+
+static bool BenchmarkTileDefs(uint16_t &solid_id, uint16_t &open_id)
+{
+    solid_id = 0;
+    open_id = 0;
+    for (const TileDef &tile_def : pack_assets.tile_defs) {
+        if (!tile_def.id) continue;
+        if (!solid_id && (tile_def.flags & TileDef::FLAG_SOLID)) solid_id = tile_def.id;
+        if (!open_id && !(tile_def.flags & TileDef::FLAG_SOLID)) open_id = tile_def.id;
+    }
+    return solid_id && open_id;
+}
+Tilemap *BenchmarkTilemap(const char *benchmark, uint16_t width, uint16_t height, int wallOdds, int wallRows)
+{
+    uint16_t solid_id = 0;
+    uint16_t open_id = 0;
+    if (!BenchmarkTileDefs(solid_id, open_id)) {
+        printf("[%s] benchmark skipped, need at least one solid and one non-solid tile def\n", benchmark);
+        return 0;
+    }
+
+    Tilemap *map = new Tilemap;
+    map->width = width;
+    map->height = height;
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        map->layers[layer].resize(map->width * map->height);
+    }
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            const uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+            const bool wall = wallRows && y % wallRows == wallRows - 1 && (x + y * 5) % (wallRows * 4) >= 4;
+            map->layers[TILE_LAYER_GROUND][y * map->width + x] = (hash % wallOdds && !wall) ? open_id : solid_id;
+        }
+    }
+    map->LayersToChunks();
+    return map;
+}
+void BenchmarkToggleTile(Tilemap &map, uint16_t x, uint16_t y, double now)
+{
+    uint16_t solid_id = 0;
+    uint16_t open_id = 0;
+    BenchmarkTileDefs(solid_id, open_id);
+    map.Set(TILE_LAYER_GROUND, x, y, map.IsSolid(x, y) ? open_id : solid_id, now, false);
+}
+
+void TilemapBenchmark(void)
+{
+    Tilemap *map = BenchmarkTilemap("tilemap", 256, 256, 5, 0);
+    if (!map) {
+        return;
+    }
+
+    const int tickCount = 1000;
+    double startedAt = 0;
+    double elapsed = 0;
+
+    // Rebuilding every edge every tick (what Update used to do)
+    startedAt = yojimbo_time();
+    for (int tick = 0; tick < tickCount; tick++) {
+        map->InvalidateSolidity();
+        map->Update(tick * SV_TICK_DT, false);
+    }
+    elapsed = yojimbo_time() - startedAt;
+    printf("[tilemap] full rebuild: %dx%d map, %zu edges, %.3f ms/tick\n",
+        map->width, map->height, map->edges.size(), elapsed * 1000 / tickCount);
+
+    // Static map, nothing changed
+    startedAt = yojimbo_time();
+    for (int tick = 0; tick < tickCount; tick++) {
+        map->Update(tick * SV_TICK_DT, false);
+    }
+    elapsed = yojimbo_time() - startedAt;
+    printf("[tilemap] static map: %.3f ms/tick\n", elapsed * 1000 / tickCount);
+
+    // One tile flips solidity every tick
+    startedAt = yojimbo_time();
+    for (int tick = 0; tick < tickCount; tick++) {
+        const uint16_t x = (uint16_t)((tick * 37) % map->width);
+        const uint16_t y = (uint16_t)((tick * 91) % map->height);
+        BenchmarkToggleTile(*map, x, y, tick * SV_TICK_DT);
+        map->Update(tick * SV_TICK_DT, false);
+    }
+    elapsed = yojimbo_time() - startedAt;
+    printf("[tilemap] 1 tile changed: %.3f ms/tick\n", elapsed * 1000 / tickCount);
+
+    // Point queries, e.g. from Anya
+    int solidCount = 0;
+    startedAt = yojimbo_time();
+    for (int i = 0; i < 100; i++) {
+        for (int y = 0; y < map->height; y++) {
+            for (int x = 0; x < map->width; x++) {
+                solidCount += map->IsSolid(x, y);
+            }
+        }
+    }
+    elapsed = yojimbo_time() - startedAt;
+    printf("[tilemap] IsSolid: %.2f ns/query (%d solid)\n",
+        elapsed * 1e9 / (100.0 * map->width * map->height), solidCount);
+
+    // Entity vs. edge collision, with and without the broadphase
+    std::vector<Entity> entities(4096);
+    for (int i = 0; i < entities.size(); i++) {
+        Entity &entity = entities[i];
+        entity.type = Entity::TYP_NPC;
+        entity.hp = 1;
+        entity.radius = 10;
+        entity.position = {
+            (float)((i * 7919) % (map->width * TILE_W)),
+            (float)((i * 104729) % (map->height * TILE_W)),
+            0
+        };
+    }
+    for (int broadphase = 0; broadphase < 2; broadphase++) {
+        const int roundCount = broadphase ? 100 : 2;
+        startedAt = yojimbo_time();
+        for (int round = 0; round < roundCount; round++) {
+            for (const Entity &entity : entities) {
+                Entity resolved = entity;
+                map->ResolveEntityCollisionsEdges(resolved, broadphase);
+            }
+        }
+        elapsed = yojimbo_time() - startedAt;
+        printf("[tilemap] ResolveEntityCollisionsEdges (%s): %.2f us/entity\n",
+            broadphase ? "broadphase" : "all edges", elapsed * 1e6 / ((double)roundCount * entities.size()));
+    }
+    for (const Entity &entity : entities) {
+        Entity withGrid = entity;
+        Entity withoutGrid = entity;
+        map->ResolveEntityCollisionsEdges(withGrid, true);
+        map->ResolveEntityCollisionsEdges(withoutGrid, false);
+        assert(Vector3Equals(withGrid.position, withoutGrid.position));
+    }
+
+    // Incremental rebuild must match a full rebuild exactly
+    Edge::Array incremental = map->edges;
+    map->InvalidateSolidity();
+    map->Update(0, false);
+    assert(incremental.size() == map->edges.size());
+    for (size_t i = 0; i < incremental.size(); i++) {
+        assert(Vector2Equals(incremental[i].line.start, map->edges[i].line.start));
+        assert(Vector2Equals(incremental[i].line.end, map->edges[i].line.end));
+    }
+
+    delete map;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "common.h"
 #include "anya.h"
+#include "flow_field.h"
 
 enum TileLayerType {
     TILE_LAYER_GROUND,
@@ -9,7 +10,23 @@ enum TileLayerType {
 };
 
 struct TileChunk {
-    uint16_t layers[TILE_LAYER_COUNT][SV_MAX_TILE_CHUNK_WIDTH * SV_MAX_TILE_CHUNK_WIDTH]{};
+    static const uint16_t WIDTH = SV_MAX_TILE_CHUNK_WIDTH;
+    static const uint32_t TILE_COUNT = WIDTH * WIDTH;
+    static_assert((WIDTH & (WIDTH - 1)) == 0, "chunk width must be a power of 2");
+    static_assert(TILE_COUNT % 64 == 0, "dirty mask must be whole words");
+
+    uint16_t layers[TILE_LAYER_COUNT][TILE_COUNT]{};
+    uint32_t version {};                  // bumped whenever any tile in the chunk changes
+    uint32_t cleanVersion {};             // version before the current dirty tiles were changed
+    uint64_t dirty[TILE_COUNT / 64]{};    // 1 bit per tile (x + y * WIDTH), changed since the last ClearDirtyTiles()
+    bool     anyDirty {};                 // chunk is in Tilemap::dirtyChunks
+    uint32_t solidVersion {};             // Tilemap::solidVersion when a tile in the chunk last changed solidity
+
+    // index into layers/dirty of map tile x,y
+    static inline uint32_t TileIndex(uint16_t x, uint16_t y)
+    {
+        return (uint32_t)(y % WIDTH) * WIDTH + x % WIDTH;
+    }
 };
 
 struct Tilemap {
@@ -31,7 +48,6 @@ struct Tilemap {
             }
         };
     };
-    typedef std::unordered_set<Coord, Coord::Hasher> CoordSet;
 
     struct Region {
         Coord tl;
@@ -60,6 +76,7 @@ struct Tilemap {
     // v8: add sentinel
     // v9: Vector3 path nodes
 
+    // NOTE(dlb): Only used for serialization, tiles live in chunks at runtime (see LayersToChunks)
     typedef std::array<std::vector<uint16_t>, TILE_LAYER_COUNT> TileLayers;
 
 #define HQT_TILE_MAP_FIELDS(FIELD, userdata) \
@@ -80,25 +97,75 @@ struct Tilemap {
     // Not serialized
     //-------------------------------
     //uint16_t                   net_id             {};  // for communicating efficiently w/ client about which map
-    double                     chunkLastUpdatedAt {};  // used by server to know when chunks are dirty on clients
-    CoordSet                   dirtyTiles         {};  // tiles that have changed since last snapshot was sent
+    std::vector<TileChunk>     chunks             {};  // tile storage, row-major grid of chunksW x chunksH chunks
+    uint16_t                   chunksW            {};
+    uint16_t                   chunksH            {};
+    std::vector<uint32_t>      dirtyChunks        {};  // indices of chunks with tiles changed since last snapshot was sent
     Edge::Array                edges              {};  // collision edge list
+    std::vector<Edge::Array>   edgeRows           {};  // cached horizontal edges, one list per row boundary (height + 1)
+    std::vector<Edge::Array>   edgeCols           {};  // cached vertical edges, one list per column boundary (width + 1)
+    std::vector<bool>          edgeRowsDirty      {};  // row boundaries that need rebuilding
+    std::vector<bool>          edgeColsDirty      {};  // column boundaries that need rebuilding
+    bool                       edgesDirty         {};  // at least one row/col boundary is dirty
+    bool                       edgesDirtyAll      {true};  // rebuild everything (new map, resize, tile def flags changed)
+    std::vector<Collision>     collisionScratch   {};  // scratch for ResolveEntityCollisionsEdges
+    std::vector<uint64_t>      solidBits          {};  // 1 bit per tile, padded with a ring of solid tiles (see SolidRow)
+    uint32_t                   solidBitsStride    {};  // uint64_t words per padded row
+    uint16_t                   solidBitsWidth     {};  // map size solidBits was built for
+    uint16_t                   solidBitsHeight    {};
+    bool                       solidBitsDirty     {true};  // rebuild solidBits before the next query
+    uint32_t                   solidVersion       {};  // bumped whenever any tile's solidity (may have) changed
     std::vector<Anya_Interval> intervals          {};  // ANYA intervals
+    std::vector<uint64_t>      autotileScratch    {};  // tiles to autotile, 1 bit per tile (see AutotileChanged)
+    std::vector<FlowField>     flowFields         {};  // see FlowTo, dropped once nobody's used them for SV_FLOW_FIELD_TTL
     std::unordered_map<Coord, uint16_t, Coord::Hasher> obj_by_coord {};
 
     //-------------------------------
     // Clean this section up
     //-------------------------------
+    // Chunks
+    void Resize(uint16_t new_width, uint16_t new_height);  // keeps existing tiles that are still in bounds
+    void LayersToChunks(void);  // after loading
+    void ChunksToLayers(void);  // before saving
+    TileChunk &ChunkAt(uint16_t x, uint16_t y);  // chunk containing tile x,y
+    void ClearDirtyTiles(void);
+
     // Tiles
     uint16_t At(TileLayerType layer, uint16_t x, uint16_t y);
     bool AtTry(TileLayerType layer, int x, int y, uint16_t &tile_id);
     bool WorldToTileIndex(int world_x, int world_y, Coord &coord);
     bool AtWorld(TileLayerType layer, int world_x, int world_y, uint16_t &tile_id);
-    bool IsSolid(int x, int y);  // tile x,y coord, returns true if out of bounds
+    // tile x,y coord, returns true if out of bounds
+    inline bool IsSolid(int x, int y)
+    {
+        if ((unsigned)x >= width || (unsigned)y >= height) {
+            return true;
+        }
+        const uint64_t *row = SolidRow(y);
+        const uint32_t bit = (uint32_t)x + 1;
+        return (row[bit >> 6] >> (bit & 63)) & 1;
+    }
+    // Padded solidity row for -1 <= y <= height, solidBitsStride words long. Bit (x + 1) is tile x,
+    // bit 0 and every bit past the right edge of the map are solid (as are rows -1 and height).
+    inline const uint64_t *SolidRow(int y)
+    {
+        if (solidBitsDirty || solidBitsWidth != width || solidBitsHeight != height) {
+            UpdateSolidBits();
+        }
+        assert(y >= -1 && y <= height);
+        return &solidBits[(size_t)(y + 1) * solidBitsStride];
+    }
 
     void Autotile(TileLayerType layer, uint16_t x, uint16_t y, double now);
+    // For bulk edits done with autotile = false, autotiles each affected tile once instead of 9
+    // times per tile changed
+    void AutotileRegion(TileLayerType layer, const Region &region, double now);  // region (inclusive) + 1 tile border
+    void AutotileChanged(TileLayerType layer, const std::vector<Coord> &changed, double now);  // 3x3 around each tile
     void Set(TileLayerType layer, uint16_t x, uint16_t y, uint16_t tile_id, double now, bool autotile = true);
     bool SetTry(TileLayerType layer, uint16_t x, uint16_t y, uint16_t tile_id, double now, bool autotile = true);
+    // Copies tile_ids[TILE_LAYER_COUNT][h][w] into a rect within one chunk, without autotiling. Bumps
+    // the chunk version once, edges and intervals are rebuilt by the next Update.
+    void SetChunkTiles(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *tile_ids);
     void SetFromWangMap(WangMap &wangMap, double now);
     
     void Flood(TileLayerType layer, uint16_t x, uint16_t y, uint16_t new_tile_id, double now);
@@ -111,9 +178,16 @@ struct Tilemap {
     uint16_t GetNextPathNodeIndex(uint16_t pathId, uint16_t pathNodeIndex);
     AiPathNode *GetPathNode(uint16_t pathId, uint16_t pathNodeIndex);
 
+    // Flow field leading to goal (tile coords) from up to radius tiles away. Everything chasing the
+    // same key (e.g. the goal entity's id) shares one field, it's only recomputed when the goal
+    // moves to another tile or the map's solidity changes. Valid until the next Update.
+    const FlowField &FlowTo(uint32_t key, Coord goal, uint16_t radius, double now);
+
     void Update(double now, bool simulate);
+    void InvalidateSolidity(void);  // call when solidity changes without going through Set (e.g. tile def flags)
 
-    void ResolveEntityCollisionsEdges(Entity &entity);
+    // broadphase = false tests against every edge (for benchmarks and debugging)
+    void ResolveEntityCollisionsEdges(Entity &entity, bool broadphase = true);
     void ResolveEntityCollisionsTriggers(Entity &entity);
 
     void Draw(Camera2D &camera, DrawCmdQueue &sortedDraws);
@@ -127,6 +201,19 @@ struct Tilemap {
 
 private:
     void UpdatePower(double now);
-    void UpdateEdges(void);
+    bool ComputeSolid(uint16_t x, uint16_t y);
+    void UpdateSolid(uint16_t x, uint16_t y);  // after tile x,y changed
+    void UpdateSolidBits(void);
+    void MarkEdgesDirty(uint16_t x, uint16_t y);
+    void UpdateEdgeRow(int y);
+    void UpdateEdgeCol(int x);
+    bool UpdateEdges(void);  // returns true if the edge list changed
     void UpdateIntervals(void);
-};
\ No newline at end of file
+};
+// Benchmark map of scattered walls (about 1 in wallOdds tiles), plus a long wall every wallRows
+// rows (if not 0) with gaps so paths have to wind back and forth. Null if there are no tile defs
+// to build it from. Caller deletes it.
+Tilemap *BenchmarkTilemap(const char *benchmark, uint16_t width, uint16_t height, int wallOdds, int wallRows);
+// Flips tile x,y between solid and open, like a door opening and closing
+void BenchmarkToggleTile(Tilemap &map, uint16_t x, uint16_t y, double now);
+void TilemapBenchmark(void);
@@ -178,16 +178,19 @@ void Editor::DrawGroundOverlay_Tiles(Camera2D &camera)
         if (editorPlaceTile) {
             Tilemap::Coord selection_center = cursor.SelectionCenter();
 
+            Tilemap::Region brush{};
+            brush.tl = { coord.x - selection_center.x, coord.y - selection_center.y };
+            brush.br = { brush.tl.x + cursor.selection_size.x - 1, brush.tl.y + cursor.selection_size.y - 1 };
+
             int i = 0;
             for (int y = 0; y < cursor.selection_size.y; y++) {
                 for (int x = 0; x < cursor.selection_size.x; x++) {
                     uint16_t tile = cursor.selection_tiles[layer][i];
-                    map.SetTry(layer,
-                        coord.x - selection_center.x + x,
-                        coord.y - selection_center.y + y, tile, now);
+                    map.SetTry(layer, brush.tl.x + x, brush.tl.y + y, tile, now, false);
                     i++;
                 }
             }
+            map.AutotileRegion(layer, brush, now);
         } else if (editorPickTile) {
             if (io.MouseButtonPressed(MOUSE_BUTTON_MIDDLE)) {
                 cursor.pick_start = coord;
@@ -981,16 +984,6 @@ void Editor::DrawUI_TileActions(UI &ui)
         uint16_t newWidth = (uint16_t)width;
         uint16_t newHeight = (uint16_t)height;
 
-        std::array<std::vector<uint16_t>, TILE_LAYER_COUNT> layersNew{};
-        for (int i = 0; i < TILE_LAYER_COUNT; i++) {
-            layersNew[i].resize(newWidth * newHeight);
-            for (uint16_t y = 0; y < map.height && y < newHeight; y++) {
-                for (uint16_t x = 0; x < map.width && x < newWidth; x++) {
-                    layersNew[i][y * newWidth + x] = map.layers[i][y * map.width + x];
-                }
-            }
-        }
-
         std::vector<ObjectData> objDataNew{};
         for (ObjectData &obj_data : map.object_data) {
             if (obj_data.x < newWidth && obj_data.y < newHeight) {
@@ -998,10 +991,8 @@ void Editor::DrawUI_TileActions(UI &ui)
             }
         }
 
-        map.layers = layersNew;
+        map.Resize(newWidth, newHeight);
         map.object_data = objDataNew;
-        map.width = (uint16_t)newWidth;
-        map.height = (uint16_t)newHeight;
     }
     ui.Newline();
 
@@ -1247,6 +1238,12 @@ void Editor::DrawUI_Tilesheet(UI &ui)
                         case 0: flags ^= TileDef::FLAG_SOLID;  break;
                         case 1: flags ^= TileDef::FLAG_LIQUID; break;
                     }
+                    if ((flags ^ tile_defs[tileIdx].flags) & TileDef::FLAG_SOLID) {
+                        // Every tile using this def may have changed solidity
+                        for (Tilemap &tile_map : pack_maps.tile_maps) {
+                            tile_map.InvalidateSolidity();
+                        }
+                    }
                     tile_defs[tileIdx].flags = (TileDef::Flags)flags;
                 } else if (state.tiles.tileEditMode == TileEditMode_AutoTileMask) {
                     //printf("x: %d, y: %d, s: %d\n", tileXSegment, tileYSegment, tileSegment);
@@ -1261,6 +1258,7 @@ void Editor::DrawUI_Tilesheet(UI &ui)
                         case 7: tile_defs[tileIdx].auto_tile_mask ^= 0b00000010; break;
                         case 8: tile_defs[tileIdx].auto_tile_mask ^= 0b00000001; break;
                     }
+                    InvalidateAutoTiles();
                 }
                 break;
             }
@@ -1636,8 +1634,7 @@ void Editor::DrawUI_EntityActions(UI &ui)
     ui.PopStyle();
     ui.Newline();
 
-    for (uint32_t i = 0; i < SV_MAX_ENTITIES; i++) {
-        Entity &entity = entityDb->entities[i];
+    for (Entity &entity : entityDb->entities) {
         if (!entity.id || entity.map_id != map.id) {
             continue;
         }
@@ -36,6 +36,18 @@ void F3Menu_Draw(GameServer &server, Camera2D &camera, Vector2 pos)
     DRAW_TEXT("time", "%.02f", server.yj_server->GetTime());
     DRAW_TEXT("tick", "%" PRIu64, server.tick);
     DRAW_TEXT("tickAccum", "%.02f", server.tickAccum);
+    DRAW_TEXT("tickTime", "%.02f ms", server.tickDuration * 1000.0);
+    DRAW_TEXT("tickLate", "%.02f ms (max %.02f ms)", server.tickLateness * 1000.0, server.tickLatenessMax * 1000.0);
+    DRAW_TEXT("tickOverrun", "%" PRIu64 " (dropped %" PRIu64 ")", server.tickOverruns, server.ticksDropped);
+    DRAW_TEXT("snapshots", "%" PRIu64 " (shared %" PRIu64 ")", server.snapshotsSent, server.snapshotsShared);
+    DRAW_TEXT("tileChunks", "%" PRIu64 " (compressed %" PRIu64 ")", server.tileChunksSent, server.tileChunksCompressed);
+    DRAW_TEXT("tileDeltas", "%" PRIu64 " (resent as chunk %" PRIu64 ")", server.tileDeltasSent, server.tileDeltasResent);
+    DRAW_TEXT("paths", "%" PRIu64 " (pending %zu, cancelled %" PRIu64 ", dropped %" PRIu64 ")",
+        server.pathService.solved, server.pathService.PendingCount(), server.pathService.cancelled, server.pathService.dropped);
+    DRAW_TEXT("pathTime", "%.02f ms (budget %.02f ms)", server.pathService.tickSearchTime * 1000.0, server.pathService.budget * 1000.0);
+    DRAW_TEXT("pathCache", "%" PRIu64 " hits, %" PRIu64 " misses (stale %" PRIu64 ", evicted %" PRIu64 ")",
+        server.pathService.cacheHits, server.pathService.cacheMisses, server.pathService.cacheStale, server.pathService.cacheEvictions);
+    DRAW_TEXT("pathHpa", "%" PRIu64 " rebuilds (last %.02f ms)", server.pathService.hpaRebuilds, server.pathService.hpaRebuildTime * 1000.0);
     DRAW_TEXT("render", "%.f, %.f", g_RenderSize.x, g_RenderSize.y);
     DRAW_TEXT("zoom", "%.2f", camera.zoom);
     DRAW_TEXT("cursorScn", "%d, %d", GetMouseX(), GetMouseY());
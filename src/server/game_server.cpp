@@ -46,8 +46,7 @@ void GameServer::OnClientJoin(int clientIdx)
         player->sprite_id = pack_assets.FindByName<Sprite>("sprite_chr_mage").id;
         //projectile->direction = DIR_E;  // what's it do if it defaults to North?
 
-        sv_player.needsChunkSync = true;
-
+        entityDb->UpdateSpatial(*player);
         BroadcastEntitySpawn(player->id);
         SendTitleShow(clientIdx, level_001.title);
     } else {
@@ -172,7 +171,6 @@ Err GameServer::Start(void)
 {
     protoDb.Load();
 
-    // NOTE(DLB): MUST happen after InitWindow() so that GetTime() is valid!!
     if (!InitializeYojimbo()) {
         printf("yj: error: failed to initialize Yojimbo!\n");
         return RN_NET_INIT_FAILED;
@@ -220,7 +218,7 @@ Err GameServer::Start(void)
         address,
         config,
         adapter,
-        GetTime()
+        now
     );
 
     // NOTE(dlb): This must be the same size as world->players[] array!
@@ -237,10 +235,14 @@ Err GameServer::Start(void)
 #endif
 
     entityDb = new EntityDB();
+    pathService.Start();
+    for (Tilemap &map : pack_maps.tile_maps) {
+        pathService.Prepare(map);
+    }
 
     return RN_SUCCESS;
 }
-void GameServer::Update(void)
+void GameServer::PumpNetwork(void)
 {
     if (!yj_server->IsRunning())
         return;
@@ -248,15 +250,50 @@ void GameServer::Update(void)
     yj_server->AdvanceTime(now);
     yj_server->ReceivePackets();
     ProcessMessages();
+}
+void GameServer::Update(void)
+{
+    if (!yj_server->IsRunning())
+        return;
+
+    PumpNetwork();
+
+    if (tickAccum >= SV_TICK_DT) {
+        tickLateness = tickAccum - SV_TICK_DT;
+        tickLatenessMax = MAX(tickLatenessMax, tickLateness);
+    }
 
     bool hasDelta = false;
-    while (tickAccum >= SV_TICK_DT) {
+    int ticksRun = 0;
+    while (tickAccum >= SV_TICK_DT && ticksRun < SV_TICK_MAX_CATCHUP) {
+        const double tickStartedAt = yojimbo_time();
         Tick();
+        tickDuration = yojimbo_time() - tickStartedAt;
+        if (tickDuration > SV_TICK_DT) {
+            tickOverruns++;
+        }
         tickAccum -= SV_TICK_DT;
+        ticksRun++;
         hasDelta = true;
     }
 
-    // TODO(dlb): Calculate actual state deltas
+    if (tickAccum >= SV_TICK_DT) {
+        // We're too far behind to catch up, drop the backlog rather than spiral
+        const uint64_t dropped = (uint64_t)(tickAccum / SV_TICK_DT);
+        tickAccum -= dropped * SV_TICK_DT;
+        ticksDropped += dropped;
+    }
+
+    // NOTE(dlb): Overruns happen under load, printing every one would only make the next tick later
+    if (now - tickReportedAt >= 1.0 && (tickOverruns != tickOverrunsReported || ticksDropped != ticksDroppedReported)) {
+        const uint64_t dropped = ticksDropped - ticksDroppedReported;
+        printf("[game_server] %" PRIu64 " ticks overran, dropped %" PRIu64 " ticks (%.2f ms) since the last report\n",
+            tickOverruns - tickOverrunsReported, dropped, dropped * SV_TICK_DT * 1000);
+        tickReportedAt = now;
+        tickOverrunsReported = tickOverruns;
+        ticksDroppedReported = ticksDropped;
+    }
+
     if (hasDelta) {
         SendClientSnapshots();
         DestroyDespawnedEntities();
@@ -265,16 +302,36 @@ void GameServer::Update(void)
     SendClockSync();
     yj_server->SendPackets();
 }
+void GameServer::WaitForNextTick(void)
+{
+    // Sleep until the next tick is due, waking up every SV_TICK_POLL_DT to pull packets off
+    // the socket so that client input gets queued as soon as it arrives rather than once per tick.
+    const double nextTickAt = now + (SV_TICK_DT - tickAccum);
+    for (;;) {
+        const double remaining = nextTickAt - yojimbo_time();
+        if (remaining <= 0) {
+            break;
+        }
+
+        if (remaining > SV_TICK_SLEEP_SLACK) {
+            yojimbo_sleep(MIN(remaining - SV_TICK_SLEEP_SLACK, SV_TICK_POLL_DT));
+            now = yojimbo_time();
+            PumpNetwork();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
 void GameServer::Stop(void)
 {
+    pathService.Stop();
     yj_server->Stop();
     delete entityDb;
 }
 
 Entity *GameServer::SpawnEntity(Entity::Type type)
 {
-    uint32_t entityId = nextEntityId++;
-    Entity *entity = entityDb->SpawnEntity(entityId, type, now);
+    Entity *entity = entityDb->SpawnEntity(type, now);
     return entity;
 }
 Entity *GameServer::SpawnEntityProto(uint16_t map_id, Vector3 position, EntityProto &proto)
@@ -287,13 +344,8 @@ Entity *GameServer::SpawnEntityProto(uint16_t map_id, Vector3 position, EntityPr
 
     entity->spec                 = proto.spec;
     entity->map_id               = map_id;
-    entity->name                 = proto.name;
     entity->position             = position;
-    entity->ambient_fx           = proto.ambient_fx;
-    entity->ambient_fx_delay_min = proto.ambient_fx_delay_min;
-    entity->ambient_fx_delay_max = proto.ambient_fx_delay_max;
     entity->radius               = proto.radius;
-    entity->dialog_root_key      = proto.dialog_root_key;
     entity->hp_max               = proto.hp_max;
     entity->hp                   = entity->hp_max;
     entity->path_id              = proto.path_id;  // TODO: Give the path a name, e.g. "PATH_TOWN_LILY"
@@ -302,12 +354,20 @@ Entity *GameServer::SpawnEntityProto(uint16_t map_id, Vector3 position, EntityPr
     entity->sprite_id            = proto.sprite_id;
     entity->direction            = proto.direction;
 
+    EntityCold &cold = *entity->cold;
+    cold.name                 = proto.name;
+    cold.ambient_fx           = proto.ambient_fx;
+    cold.ambient_fx_delay_min = proto.ambient_fx_delay_min;
+    cold.ambient_fx_delay_max = proto.ambient_fx_delay_max;
+    cold.dialog_root_key      = proto.dialog_root_key;
+
     AiPathNode *aiPathNode = map.GetPathNode(entity->path_id, 0);
     if (aiPathNode) {
         entity->position.x = aiPathNode->pos.x;
         entity->position.y = aiPathNode->pos.y;
     }
 
+    entityDb->UpdateSpatial(*entity);
     return entity;
 }
 Entity *GameServer::SpawnProjectile(uint16_t map_id, Vector3 position, Vector2 direction, Vector3 initial_velocity)
@@ -338,6 +398,7 @@ Entity *GameServer::SpawnProjectile(uint16_t map_id, Vector3 position, Vector2 d
     projectile->sprite_id = pack_assets.FindByName<Sprite>("sprite_prj_fireball").id;
     //projectile->direction = DIR_E;
 
+    entityDb->UpdateSpatial(*projectile);
     BroadcastEntitySpawn(projectile->id);
     return projectile;
 }
@@ -350,13 +411,9 @@ void GameServer::WarpEntity(Entity &entity, uint16_t dest_map_id, Vector3 dest_p
         entity.force_accum = {};
         entity.velocity = {};
         entity.last_moved_at = now;
+        entityDb->UpdateSpatial(entity);
 
         if (entity.type == Entity::TYP_PLAYER) {
-            ServerPlayer *s_player = FindServerPlayer(entity.id);
-            if (s_player) {
-                s_player->needsChunkSync = true;
-            }
-
             Tilemap &map = pack_maps.FindById<Tilemap>(entity.map_id);
             if (map.title.size()) {
                 int clientIdx = 0;
@@ -412,6 +469,7 @@ void GameServer::DespawnEntity(uint32_t entityId)
 {
     if (entityDb->DespawnEntity(entityId, now)) {
         BroadcastEntityDespawn(entityId);
+        pathService.Cancel(entityId);
 
         Entity *entity = entityDb->FindEntity(entityId, true);
 
@@ -545,7 +603,7 @@ void GameServer::TickSpawnCaveNPCs(uint16_t map_id)
             entity = SpawnEntity(Entity::TYP_NPC);
             if (!entity) continue;
 
-            entity->name = "Cave Lily";
+            entity->cold->name = "Cave Lily";
 
             entity->map_id = map_id;
             entity->position = { 100, 100 };
@@ -561,11 +619,49 @@ void GameServer::TickSpawnCaveNPCs(uint16_t map_id)
             entity->sprite_id = pack_assets.FindByName<Sprite>("sprite_npc_lily").id;
             //entity->direction = DIR_E;
 
+            entityDb->UpdateSpatial(*entity);
             BroadcastEntitySpawn(entity->id);
             eid_bots[i] = entity->id;
         }
     }
 }
+static void ChickenWanderRandomly(Entity &e_npc)
+{
+    Vector3 dir{};
+    dir.x = GetRandomFloatMinusOneToOne();
+    dir.y = GetRandomFloatMinusOneToOne();
+    e_npc.path_rand_direction = Vector3Normalize(dir);
+    e_npc.path_rand_duration = GetRandomValue(2, 4);
+}
+// Aims e_npc at the next tile on the flow field toward target. Returns false if it's too far away
+// (or can't get there from here).
+static bool ChickenFlowToward(Tilemap &map, Entity &e_npc, Entity &target, double now)
+{
+    Vector2 npcPos = e_npc.Position2D();
+    Vector2 targetPos = target.Position2D();
+    Tilemap::Coord npcCoord{};
+    Tilemap::Coord targetCoord{};
+    if (!map.WorldToTileIndex(npcPos.x, npcPos.y, npcCoord) ||
+        !map.WorldToTileIndex(targetPos.x, targetPos.y, targetCoord)) {
+        return false;
+    }
+
+    // NOTE(dlb): Every chicken chasing the same target shares its field
+    const FlowField &field = map.FlowTo(target.id, targetCoord, SV_FLOW_FIELD_RADIUS, now);
+    Tilemap::Coord next{};
+    if (!field.NextTile(npcCoord.x, npcCoord.y, next.x, next.y)) {
+        return false;
+    }
+
+    // Middle of the next tile, or straight at the target once we're on its tile
+    Vector2 moveTo = targetPos;
+    if (!(next == npcCoord)) {
+        moveTo = { (next.x + 0.5f) * TILE_W, (next.y + 0.5f) * TILE_W };
+    }
+    Vector2 dir = Vector2Normalize(Vector2Subtract(moveTo, npcPos));
+    e_npc.path_rand_direction = { dir.x, dir.y, 0.0f };
+    return true;
+}
 void GameServer::TickEntityNPC(Entity &e_npc, double dt, double now)
 {
     Tilemap &map = pack_maps.FindById<Tilemap>(e_npc.map_id);
@@ -622,57 +718,81 @@ void GameServer::TickEntityNPC(Entity &e_npc, double dt, double now)
 
     // Chicken pathing AI (really bad)
     if (e_npc.spec == Entity::SPC_NPC_CHICKEN) {
-        if (now - e_npc.path_rand_started_at >= e_npc.path_rand_duration) {
+        // NOTE(dlb): While a path is pending, stand still until TickPathResult picks a direction
+        if (!pathService.IsPending(e_npc.id) && now - e_npc.path_rand_started_at >= e_npc.path_rand_duration) {
             e_npc.path_rand_duration = 0;
             e_npc.path_rand_started_at = now;
 
             // Start moving
-            if (Vector3Equals(e_npc.path_rand_direction, Vector3Zero())) {
+            if (Vector3Equals(e_npc.path_rand_direction, Vector3Zero()) && !e_npc.path_rand_flow) {
                 // Toward player, if possible
+                bool pathRequested = false;
                 auto player0 = entityDb->FindEntity(players[0].entityId);
                 if (player0 && player0->map_id == e_npc.map_id) {
-                    Vector2 npcPos = e_npc.Position2D();
-                    Vector2 playerPos = player0->Position2D();
-                    Tilemap::Coord npcCoord{};
-                    Tilemap::Coord playerCoord{};
-                    if (map.WorldToTileIndex(npcPos.x, npcPos.y, npcCoord) &&
-                        map.WorldToTileIndex(playerPos.x, playerPos.y, playerCoord)) {
-                        Vector2 start{ (float)npcCoord.x, (float)npcCoord.y };
-                        Vector2 target{ (float)playerCoord.x, (float)playerCoord.y };
-                        Anya_State state{ start, target, Tilemap::Tilemap_AnyaSolidQuery, &map };
-                        Anya(state, e_npc.radius);
-                        if (state.path.size() > 1) {
-                            Vector2 toPlayer = Vector2Normalize(Vector2Subtract(state.path[1], npcPos));
-                            e_npc.path_rand_direction = { toPlayer.x, toPlayer.y, 0.0f };
-                            e_npc.path_rand_duration = GetRandomValue(1, 8);
+                    if (ChickenFlowToward(map, e_npc, *player0, now)) {
+                        // Close by, no need for a search
+                        e_npc.path_rand_flow = true;
+                        e_npc.path_rand_duration = GetRandomValue(1, 8);
+                        pathRequested = true;
+                    } else {
+                        Vector2 npcPos = e_npc.Position2D();
+                        Vector2 playerPos = player0->Position2D();
+                        Tilemap::Coord npcCoord{};
+                        Tilemap::Coord playerCoord{};
+                        if (map.WorldToTileIndex(npcPos.x, npcPos.y, npcCoord) &&
+                            map.WorldToTileIndex(playerPos.x, playerPos.y, playerCoord)) {
+                            Vector2 start{ (float)npcCoord.x, (float)npcCoord.y };
+                            Vector2 target{ (float)playerCoord.x, (float)playerCoord.y };
+                            pathRequested = pathService.Request(map, e_npc.id, start, target, e_npc.radius);
                         }
                     }
                 }
                 
                 // Randomly, if not
-                if (!e_npc.path_rand_duration) {
-                    Vector3 dir{};
-                    dir.x = GetRandomFloatMinusOneToOne();
-                    dir.y = GetRandomFloatMinusOneToOne();
-                    e_npc.path_rand_direction = Vector3Normalize(dir);
-                    e_npc.path_rand_duration = GetRandomValue(2, 4);
+                if (!pathRequested) {
+                    ChickenWanderRandomly(e_npc);
                 }
             } else {
                 // Stop moving for a bit
                 e_npc.path_rand_direction = {};
+                e_npc.path_rand_flow = false;
                 e_npc.path_rand_duration = GetRandomValue(2, 12);
             }
         }
 
+        if (e_npc.path_rand_flow) {
+            // Re-aim every tick, the field knows the way around walls
+            auto player0 = entityDb->FindEntity(players[0].entityId);
+            if (!player0 || player0->map_id != e_npc.map_id || !ChickenFlowToward(map, e_npc, *player0, now)) {
+                // Player got away, stand around until the next decision
+                e_npc.path_rand_flow = false;
+                e_npc.path_rand_direction = {};
+            }
+        }
+
         Vector3 move = Vector3Scale(e_npc.path_rand_direction, e_npc.speed);
         e_npc.ApplyForce(move);
     }
-
-    entityDb->EntityTick(e_npc, dt, now);
 }
-void GameServer::TickEntityPlayer(Entity &e_player, double dt, double now)
+void GameServer::TickPathResult(const PathResult &result)
 {
-    entityDb->EntityTick(e_player, dt, now);
+    Entity *entity = entityDb->FindEntity(result.entity_id);
+    if (!entity || entity->map_id != result.map_id) {
+        return;
+    }
+    Entity &e_npc = *entity;
+
+    if (e_npc.spec == Entity::SPC_NPC_CHICKEN) {
+        e_npc.path_rand_started_at = now;
+        if (result.path.size() > 1) {
+            // NOTE(dlb): Requests are in tile coords, but the path comes back in world coords
+            Vector2 toPlayer = Vector2Normalize(Vector2Subtract(result.path[1], e_npc.Position2D()));
+            e_npc.path_rand_direction = { toPlayer.x, toPlayer.y, 0.0f };
+            e_npc.path_rand_duration = GetRandomValue(1, 8);
+        } else {
+            ChickenWanderRandomly(e_npc);
+        }
+    }
 }
 void GameServer::TickEntityProjectile(Entity &e_projectile, double dt, double now)
 {
@@ -680,8 +800,6 @@ void GameServer::TickEntityProjectile(Entity &e_projectile, double dt, double no
     //AspectPhysics &ePhysics = map.ePhysics[entityIndex];
     //playerEntity.ApplyForce({ 0, 5 });
 
-    entityDb->EntityTick(e_projectile, dt, now);
-
     if (now - e_projectile.spawned_at > 1.0) {
         DespawnEntity(e_projectile.id);
     }
@@ -690,7 +808,16 @@ void GameServer::TickEntityProjectile(Entity &e_projectile, double dt, double no
         return;
     }
 
-    for (Entity &e_target : entityDb->entities) {
+    // Only things whose sprite could possibly overlap ours
+    Rectangle searchRect = e_projectile.GetSpriteRect();
+    searchRect.x -= SV_ENTITY_MAX_EXTENT;
+    searchRect.y -= SV_ENTITY_MAX_EXTENT;
+    searchRect.width += SV_ENTITY_MAX_EXTENT * 2;
+    searchRect.height += SV_ENTITY_MAX_EXTENT * 2;
+    entityDb->QueryRect(e_projectile.map_id, searchRect, nearbyEntities);
+
+    for (Entity *e_target_ptr : nearbyEntities) {
+        Entity &e_target = *e_target_ptr;
         if (e_target.type == Entity::TYP_NPC
             && !e_target.despawned_at
             && e_target.Alive()
@@ -710,11 +837,11 @@ void GameServer::TickEntityProjectile(Entity &e_projectile, double dt, double no
                         switch (e_target.spec) {
                             case Entity::SPC_NPC_TOWNFOLK: {
                                 //BroadcastEntitySay(victim.id, TextFormat("Ouch! You hit me with\nprojectile #%u!", entity.id));
-                                BroadcastEntitySay(e_target.id, e_target.name, "Ouch!");
+                                BroadcastEntitySay(e_target.id, e_target.cold->name, "Ouch!");
                                 break;
                             }
                             case Entity::SPC_NPC_CHICKEN: {
-                                BroadcastEntitySay(e_target.id, e_target.name, "*squawk*!");
+                                BroadcastEntitySay(e_target.id, e_target.cold->name, "*squawk*!");
                                 break;
                             }
                         }
@@ -766,7 +893,17 @@ void GameServer::Tick(void)
     TickSpawnTownNPCs(map_overworld.id);
     TickSpawnCaveNPCs(map_cave.id);
 
-    // Tick entites
+    // Paths requested on earlier ticks
+    pathService.Tick(pathResults);
+    for (const PathResult &result : pathResults) {
+        TickPathResult(result);
+    }
+
+    // Tick entites: think (AI pushes things around), move everyone on a map in one batch, then
+    // deal with whatever they ran into
+    for (auto &batch : tickBatches) {
+        batch.second.clear();
+    }
     for (Entity &entity : entityDb->entities) {
         if (!entity.type || entity.despawned_at) {
             continue;
@@ -776,18 +913,37 @@ void GameServer::Tick(void)
         // TODO: if (map.sleeping) continue
 
         switch (entity.type) {
-            case Entity::TYP_NPC:        TickEntityNPC        (entity, SV_TICK_DT, now); break;
-            case Entity::TYP_PLAYER:     TickEntityPlayer     (entity, SV_TICK_DT, now); break;
-            case Entity::TYP_PROJECTILE: TickEntityProjectile (entity, SV_TICK_DT, now); break;
+            case Entity::TYP_NPC: TickEntityNPC(entity, SV_TICK_DT, now); break;
         }
 
-        Tilemap &map = pack_maps.FindById<Tilemap>(entity.map_id);
-        map.ResolveEntityCollisionsEdges(entity);
-        map.ResolveEntityCollisionsTriggers(entity);
-        TickResolveEntityWarpCollisions(map, entity);
+        tickBatches[entity.map_id].push_back(&entity);
+    }
+
+    for (auto &batch : tickBatches) {
+        entityDb->EntityTickBatch(batch.second.data(), batch.second.size(), SV_TICK_DT, now);
+    }
+
+    for (auto &batch : tickBatches) {
+        for (Entity *entityPtr : batch.second) {
+            Entity &entity = *entityPtr;
+
+            switch (entity.type) {
+                case Entity::TYP_PROJECTILE: TickEntityProjectile(entity, SV_TICK_DT, now); break;
+            }
+            // Projectile expired, or hit something that died (possibly earlier in this batch)
+            if (entity.despawned_at) {
+                continue;
+            }
+
+            Tilemap &map = pack_maps.FindById<Tilemap>(entity.map_id);
+            map.ResolveEntityCollisionsEdges(entity);
+            map.ResolveEntityCollisionsTriggers(entity);
+            TickResolveEntityWarpCollisions(map, entity);
+            entityDb->UpdateSpatial(entity);  // collisions can push entities around
 
-        bool newlySpawned = entity.spawned_at == now;
-        UpdateSprite(entity, SV_TICK_DT, newlySpawned);
+            bool newlySpawned = entity.spawned_at == now;
+            UpdateSprite(entity, SV_TICK_DT, newlySpawned);
+        }
     }
 
     tick++;
@@ -809,8 +965,9 @@ void GameServer::SerializeSpawn(uint32_t entityId, Msg_S_EntitySpawn &entitySpaw
     entitySpawn.entity_id = entity->id;
     entitySpawn.type      = entity->type;
     entitySpawn.spec      = entity->spec;
-    strncpy(entitySpawn.name,   entity->name.c_str(), SV_MAX_ENTITY_NAME_LEN);
+    strncpy(entitySpawn.name,   entity->cold->name.c_str(), SV_MAX_ENTITY_NAME_LEN);
     entitySpawn.map_id    = entity->map_id;
+    entitySpawn.bounds    = WorldNetBounds();
     entitySpawn.position  = entity->position;
 
     // Collision
@@ -828,52 +985,64 @@ void GameServer::SerializeSpawn(uint32_t entityId, Msg_S_EntitySpawn &entitySpaw
     // Sprite
     entitySpawn.sprite_id = entity->sprite_id;
 }
-void GameServer::SendEntitySpawn(int clientIdx, uint32_t entityId)
+bool GameServer::SendEntitySpawn(int clientIdx, uint32_t entityId)
 {
     Entity *entity = entityDb->FindEntity(entityId);
     if (!entity) {
         printf("[game_server] could not find entity id %u. cannot send entity spawn msg.\n", entityId);
-        return;
+        return false;
     }
 
     if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT)) {
         Msg_S_EntitySpawn *msg = (Msg_S_EntitySpawn *)yj_server->CreateMessage(clientIdx, MSG_S_ENTITY_SPAWN);
         if (msg) {
             SerializeSpawn(entityId, *msg);
+            // TODO: MSG_S_ACK_INPUT as unrealible msg? (keep max on receiving end)
+            ServerPlayer &serverPlayer = players[clientIdx];
+            if (entityId == serverPlayer.entityId) {
+                msg->last_processed_input_cmd = serverPlayer.lastInputSeq;
+            }
             yj_server->SendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT, msg);
+            return true;
         }
     }
+    return false;
 }
 void GameServer::BroadcastEntitySpawn(uint32_t entityId)
 {
+    Entity *entity = entityDb->FindEntity(entityId);
+    if (!entity) {
+        return;
+    }
+
+    // Only to the clients that can see it. Everyone else gets it when it becomes relevant to
+    // them, see UpdateRelevance().
     for (int clientIdx = 0; clientIdx < SV_MAX_PLAYERS; clientIdx++) {
         if (!yj_server->IsClientConnected(clientIdx)) {
             continue;
         }
         ServerPlayer &serverPlayer = players[clientIdx];
-        if (serverPlayer.joinedAt == now) {
-            // they'll be receiving a full snapshot this frame
+        if (serverPlayer.relevantEntities.contains(entityId)) {
             continue;
         }
-
-        SendEntitySpawn(clientIdx, entityId);
+        Entity *viewer = entityDb->FindEntity(serverPlayer.entityId);
+        if (viewer && IsRelevant(*viewer, *entity, false) && SendEntitySpawn(clientIdx, entityId)) {
+            serverPlayer.relevantEntities.insert(entityId);
+            serverPlayer.relevantHash += EntityIdHash(entityId);
+        }
     }
 }
-void GameServer::SendEntityDespawn(int clientIdx, uint32_t entityId)
+bool GameServer::SendEntityDespawn(int clientIdx, uint32_t entityId)
 {
-    Entity *entity = entityDb->FindEntity(entityId, true);
-    if (!entity) {
-        printf("[game_server] could not find entity id %u. cannot send entity despawn msg.\n", entityId);
-        return;
-    }
-
     if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT)) {
         Msg_S_EntityDespawn *msg = (Msg_S_EntityDespawn *)yj_server->CreateMessage(clientIdx, MSG_S_ENTITY_DESPAWN);
         if (msg) {
             msg->entityId = entityId;
             yj_server->SendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT, msg);
+            return true;
         }
     }
+    return false;
 }
 void GameServer::BroadcastEntityDespawn(uint32_t entityId)
 {
@@ -882,12 +1051,15 @@ void GameServer::BroadcastEntityDespawn(uint32_t entityId)
             continue;
         }
         ServerPlayer &serverPlayer = players[clientIdx];
-        if (serverPlayer.joinedAt == now) {
-            // they'll be receiving a full snapshot this frame
+        if (!serverPlayer.relevantEntities.contains(entityId)) {
             continue;
         }
 
-        SendEntityDespawn(clientIdx, entityId);
+        // NOTE(dlb): If this fails, UpdateRelevance() will try again next tick
+        if (SendEntityDespawn(clientIdx, entityId)) {
+            serverPlayer.relevantEntities.erase(entityId);
+            serverPlayer.relevantHash -= EntityIdHash(entityId);
+        }
     }
 }
 void GameServer::SendEntitySay(int clientIdx, uint32_t entityId, uint16_t dialogId, const std::string &title, const std::string &message)
@@ -916,93 +1088,222 @@ void GameServer::BroadcastEntitySay(uint32_t entityId, const std::string &title,
         if (!yj_server->IsClientConnected(clientIdx)) {
             continue;
         }
+        if (!players[clientIdx].relevantEntities.contains(entityId)) {
+            continue;  // they don't know this entity exists
+        }
 
         SendEntitySay(clientIdx, entityId, 0, title, message);
     }
 }
 
-void GameServer::SendTileChunk(int clientIdx, Tilemap &map, uint16_t x, uint16_t y)
+static uint64_t TileChunkKey(uint16_t map_id, uint16_t chunk_x, uint16_t chunk_y)
+{
+    // NOTE(dlb): Chunk coords rather than index, tiles keep their chunk coords when a map is resized
+    return ((uint64_t)map_id << 32) | ((uint64_t)chunk_y << 16) | chunk_x;
+}
+const TileChunkPayload &GameServer::BuildTileChunkPayload(Tilemap &map, uint16_t chunk_x, uint16_t chunk_y)
+{
+    const uint16_t x = chunk_x * TileChunk::WIDTH;
+    const uint16_t y = chunk_y * TileChunk::WIDTH;
+    const TileChunk &tileChunk = map.ChunkAt(x, y);
+
+    TileChunkPayload &payload = tileChunkPayloads[TileChunkKey(map.id, chunk_x, chunk_y)];
+    const uint16_t w = (uint16_t)MIN(map.width - x, TileChunk::WIDTH);
+    const uint16_t h = (uint16_t)MIN(map.height - y, TileChunk::WIDTH);
+    if (payload.smol.size() && payload.version == tileChunk.version && payload.w == w && payload.h == h) {
+        return payload;
+    }
+
+    std::vector<uint8_t> &chunk = tileChunkScratch;
+    chunk.clear();
+    tileCodec.Encode(tileChunk, w, h, chunk);
+
+    const int chunk_bytes = chunk.size();
+#if SV_COMPRESS_TILE_CHUNK_WITH_LZ4
+    payload.smol.resize(LZ4_compressBound(chunk_bytes));
+    const int chunk_smol_bytes = LZ4_compress_default((char *)chunk.data(), (char *)payload.smol.data(), chunk_bytes, payload.smol.size());
+    payload.smol.resize(chunk_smol_bytes);
+#else
+    int chunk_smol_bytes{};
+    uint8_t *chunk_smol = CompressData((uint8_t *)chunk.data(), chunk_bytes, &chunk_smol_bytes);
+    payload.smol.assign(chunk_smol, chunk_smol + chunk_smol_bytes);
+    MemFree(chunk_smol);
+#endif
+
+    payload.version = tileChunk.version;
+    payload.w = w;
+    payload.h = h;
+    payload.beeg_size = chunk_bytes;
+    tileChunksCompressed++;
+    return payload;
+}
+bool GameServer::SendTileChunk(int clientIdx, Tilemap &map, uint16_t chunk_x, uint16_t chunk_y)
 {
     if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_TILE_EVENT)) {
         Msg_S_TileChunk *msg = (Msg_S_TileChunk *)yj_server->CreateMessage(clientIdx, MSG_S_TILE_CHUNK);
         if (msg) {
+            const TileChunkPayload &payload = BuildTileChunkPayload(map, chunk_x, chunk_y);
+
             msg->map_id = map.id;
             msg->map_w = map.width;
             msg->map_h = map.height;
-            msg->x = x;
-            msg->y = y;
-            msg->w = MIN(map.width, SV_MAX_TILE_CHUNK_WIDTH);
-            msg->h = MIN(map.height, SV_MAX_TILE_CHUNK_WIDTH);
-
-            std::vector<uint16_t> chunk{};
-            chunk.reserve(TILE_LAYER_COUNT * msg->w * msg->h);
-            for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-                for (uint16_t ty = y; ty < msg->h; ty++) {
-                    for (uint16_t tx = x; tx < msg->w; tx++) {
-                        uint16_t tile = 0;
-                        map.AtTry((TileLayerType)layer, tx, ty, tile);
-                        chunk.push_back(tile);
-                    }
-                }
-            }
-
-            int chunk_bytes = sizeof(chunk[0]) * chunk.size();
-            int chunk_smol_bytes{};
-            uint8_t *chunk_smol{};
-#if SV_COMPRESS_TILE_CHUNK_WITH_LZ4
-            int lz4_bound = LZ4_compressBound(chunk_bytes);
-            chunk_smol = (uint8_t *)MemAlloc(lz4_bound);
-            chunk_smol_bytes = LZ4_compress_default((char *)chunk.data(), (char *)chunk_smol, chunk_bytes, lz4_bound);
-#else
-            chunk_smol = CompressData((uint8_t *)chunk.data(), chunk_bytes, &chunk_smol_bytes);
-#endif
-            uint8_t *block = yj_server->AllocateBlock(clientIdx, chunk_smol_bytes);
-            memcpy(block, chunk_smol, chunk_smol_bytes);
-            MemFree(chunk_smol);
-
-            msg->beeg_size = chunk_bytes;
-            msg->smol_size = chunk_smol_bytes;
+            msg->x = chunk_x * TileChunk::WIDTH;
+            msg->y = chunk_y * TileChunk::WIDTH;
+            msg->w = payload.w;
+            msg->h = payload.h;
+            msg->beeg_size = payload.beeg_size;
+            msg->smol_size = payload.smol.size();
             //printf("Sending tile chunk, (beeg %d, smol %d)\n", msg->beeg_size, msg->smol_size);
 
-            yj_server->AttachBlockToMessage(clientIdx, msg, block, chunk_smol_bytes);
+            // NOTE(dlb): yojimbo frees the block with the message, so every client needs its own copy
+            uint8_t *block = yj_server->AllocateBlock(clientIdx, payload.smol.size());
+            memcpy(block, payload.smol.data(), payload.smol.size());
+            yj_server->AttachBlockToMessage(clientIdx, msg, block, payload.smol.size());
             yj_server->SendMessage(clientIdx, CHANNEL_R_TILE_EVENT, msg);
+            tileChunksSent++;
+            return true;
         }
     }
+    return false;
 }
-void GameServer::BroadcastTileChunk(Tilemap &map, uint16_t x, uint16_t y)
+void GameServer::BroadcastTileChunk(Tilemap &map, uint16_t chunk_x, uint16_t chunk_y)
 {
     for (int clientIdx = 0; clientIdx < SV_MAX_PLAYERS; clientIdx++) {
         if (!yj_server->IsClientConnected(clientIdx)) {
             continue;
         }
 
-        SendTileChunk(clientIdx, map, x, y);
+        SendTileChunk(clientIdx, map, chunk_x, chunk_y);
     }
 }
-void GameServer::SendTileUpdate(int clientIdx, Tilemap &map, uint16_t x, uint16_t y)
+void GameServer::StreamTileChunks(int clientIdx, Tilemap &map, Entity &player)
 {
-    if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_TILE_EVENT)) {
-        Msg_S_TileUpdate *msg = (Msg_S_TileUpdate *)yj_server->CreateMessage(clientIdx, MSG_S_TILE_UPDATE);
-        if (msg) {
-            msg->map_id = map.id;
-            msg->x = x;
-            msg->y = y;
-            for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
-                map.AtTry((TileLayerType)layer, x, y, msg->tile_ids[layer]);
+    ServerPlayer &serverPlayer = players[clientIdx];
+    if (!map.chunksW || !map.chunksH) {
+        return;
+    }
+
+    const int centerX = CLAMP((int)(player.position.x / TILE_W) / TileChunk::WIDTH, 0, map.chunksW - 1);
+    const int centerY = CLAMP((int)(player.position.y / TILE_W) / TileChunk::WIDTH, 0, map.chunksH - 1);
+
+    // Nearest first, ring by ring, so the chunk the player is standing in shows up before the
+    // ones at the edge of the screen. Capped per tick so a warp onto a big map doesn't hog the
+    // reliable channel, the rest stream in over the next few ticks.
+    int chunksSent = 0;
+    for (int ring = 0; ring <= CL_RENDER_DISTANCE; ring++) {
+        for (int cy = centerY - ring; cy <= centerY + ring; cy++) {
+            for (int cx = centerX - ring; cx <= centerX + ring; cx++) {
+                if (MAX(abs(cx - centerX), abs(cy - centerY)) != ring) {
+                    continue;
+                }
+                if (cx < 0 || cy < 0 || cx >= map.chunksW || cy >= map.chunksH) {
+                    continue;
+                }
+
+                const uint32_t version = map.chunks[(size_t)cy * map.chunksW + cx].version;
+                const uint64_t key = TileChunkKey(map.id, cx, cy);
+                const auto sent = serverPlayer.chunkVersions.find(key);
+                if (sent != serverPlayer.chunkVersions.end() && sent->second == version) {
+                    continue;
+                }
+
+                if (chunksSent == SV_MAX_TILE_CHUNKS_PER_TICK || !SendTileChunk(clientIdx, map, cx, cy)) {
+                    return;
+                }
+                serverPlayer.chunkVersions[key] = version;
+                chunksSent++;
             }
-            yj_server->SendMessage(clientIdx, CHANNEL_R_TILE_EVENT, msg);
         }
     }
 }
-void GameServer::BroadcastTileUpdate(Tilemap &map, uint16_t x, uint16_t y)
+const TileDeltaPayload &GameServer::BuildTileDeltaPayload(Tilemap &map, uint32_t chunkIdx)
 {
-    for (int clientIdx = 0; clientIdx < SV_MAX_PLAYERS; clientIdx++) {
-        if (!yj_server->IsClientConnected(clientIdx)) {
-            continue;
+    const TileChunk &chunk = map.chunks[chunkIdx];
+    const uint16_t chunk_x = chunkIdx % map.chunksW;
+    const uint16_t chunk_y = chunkIdx / map.chunksW;
+
+    TileDeltaPayload &payload = tileDeltaPayloads[TileChunkKey(map.id, chunk_x, chunk_y)];
+    if (payload.cleanVersion == chunk.cleanVersion && payload.version == chunk.version && payload.tile_count) {
+        return payload;
+    }
+
+    payload.cleanVersion = chunk.cleanVersion;
+    payload.version = chunk.version;
+    payload.tile_count = 0;
+    payload.run_count = 0;
+    payload.data.clear();
+
+    uint32_t tile_count = 0;
+    for (uint32_t word = 0; word < ARRAY_SIZE(chunk.dirty); word++) {
+        tile_count += std::popcount(chunk.dirty[word]);
+    }
+    payload.tile_count = tile_count;
+    if (tile_count > SV_MAX_TILE_DELTA_TILES) {
+        return payload;  // cheaper to resend the chunk
+    }
+
+    // Runs of consecutive dirty bits, merged across word boundaries
+    std::vector<uint16_t> &runs = payload.data;
+    for (uint32_t word = 0; word < ARRAY_SIZE(chunk.dirty); word++) {
+        uint64_t bits = chunk.dirty[word];
+        uint32_t bit = 0;
+        while (bits) {
+            const uint32_t skip = std::countr_zero(bits);
+            bits >>= skip;
+            bit += skip;
+            const uint32_t len = std::countr_one(bits);
+            bits = len < 64 ? bits >> len : 0;
+
+            const uint16_t start = word * 64 + bit;
+            if (runs.size() && runs[runs.size() - 2] + runs.back() == start) {
+                runs.back() += len;
+            } else {
+                runs.push_back(start);
+                runs.push_back(len);
+            }
+            bit += len;
         }
+    }
+    payload.run_count = runs.size() / 2;
+
+    for (int layer = 0; layer < TILE_LAYER_COUNT; layer++) {
+        for (uint32_t run = 0; run < payload.run_count; run++) {
+            const uint16_t *tile_ids = &chunk.layers[layer][runs[run * 2]];
+            payload.data.insert(payload.data.end(), tile_ids, tile_ids + runs[run * 2 + 1]);
+        }
+    }
+    return payload;
+}
+bool GameServer::SendTileDelta(int clientIdx, Tilemap &map, uint32_t chunkIdx)
+{
+    const TileDeltaPayload &payload = BuildTileDeltaPayload(map, chunkIdx);
+    if (!payload.tile_count) {
+        return true;
+    }
+    if (payload.tile_count > SV_MAX_TILE_DELTA_TILES) {
+        tileDeltasResent++;
+        return false;
+    }
 
-        SendTileUpdate(clientIdx, map, x, y);
+    if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_TILE_EVENT)) {
+        Msg_S_TileDelta *msg = (Msg_S_TileDelta *)yj_server->CreateMessage(clientIdx, MSG_S_TILE_DELTA);
+        if (msg) {
+            msg->map_id = map.id;
+            msg->x = (chunkIdx % map.chunksW) * TileChunk::WIDTH;
+            msg->y = (chunkIdx / map.chunksW) * TileChunk::WIDTH;
+            msg->tile_count = payload.tile_count;
+            msg->run_count = payload.run_count;
+
+            const int block_size = payload.data.size() * sizeof(payload.data[0]);
+            uint8_t *block = yj_server->AllocateBlock(clientIdx, block_size);
+            memcpy(block, payload.data.data(), block_size);
+            yj_server->AttachBlockToMessage(clientIdx, msg, block, block_size);
+            yj_server->SendMessage(clientIdx, CHANNEL_R_TILE_EVENT, msg);
+            tileDeltasSent++;
+            return true;
+        }
     }
+    return false;
 }
 void GameServer::SendTitleShow(int clientIdx, const std::string &text)
 {
@@ -1039,7 +1340,7 @@ void GameServer::RequestDialog(int clientIdx, Entity &entity, Dialog &dialog)
     }
 
     if (dialog_id) {
-        SendEntitySay(clientIdx, entity.id, dialog_id, entity.name, std::string(*msg));
+        SendEntitySay(clientIdx, entity.id, dialog_id, entity.cold->name, std::string(*msg));
         entity.dialog_spawned_at = now;
     }
 }
@@ -1071,7 +1372,7 @@ void GameServer::ProcessMsg(int clientIdx, Msg_C_EntityInteract &msg)
             return;
         }
 
-        Dialog *dialog = dialog_library.FindByKey(entity->dialog_root_key);
+        Dialog *dialog = dialog_library.FindByKey(entity->cold->dialog_root_key);
         if (dialog) {
             RequestDialog(clientIdx, *entity, *dialog);
         }
@@ -1120,7 +1421,13 @@ void GameServer::ProcessMsg(int clientIdx, Msg_C_EntityInteractDialogOption &msg
 }
 void GameServer::ProcessMsg(int clientIdx, Msg_C_InputCommands &msg)
 {
-    players[clientIdx].inputQueue = msg.cmdQueue;
+    ServerPlayer &serverPlayer = players[clientIdx];
+    serverPlayer.inputQueue = msg.cmdQueue;
+
+    // NOTE(dlb): Unreliable, so acks can arrive out of order. Also don't let the client ack the future.
+    if (msg.last_snapshot_acked > serverPlayer.snapshotAcked && msg.last_snapshot_acked <= tick) {
+        serverPlayer.snapshotAcked = msg.last_snapshot_acked;
+    }
 }
 void GameServer::ProcessMsg(int clientIdx, Msg_C_TileInteract &msg)
 {
@@ -1251,31 +1558,266 @@ void GameServer::ProcessMessages(void)
     }
 }
 
-void GameServer::SerializeSnapshot(Entity &entity, Msg_S_EntitySnapshot &entitySnapshot)
+bool GameServer::IsRelevant(const Entity &viewer, const Entity &entity, bool wasRelevant)
 {
-    entitySnapshot.server_time = lastTickedAt;
+    if (entity.id == viewer.id) {
+        return true;
+    }
+    if (entity.map_id != viewer.map_id) {
+        return false;
+    }
 
+    // Hysteresis, so things right on the edge don't flicker in and out of existence
+    const float radius = wasRelevant ? SV_RELEVANCE_RADIUS + SV_RELEVANCE_HYSTERESIS : SV_RELEVANCE_RADIUS;
+    const Vector2 viewerPos{ viewer.position.x, viewer.position.y };
+    const Vector2 entityPos{ entity.position.x, entity.position.y };
+    return Vector2DistanceSqr(viewerPos, entityPos) <= radius * radius;
+}
+void GameServer::UpdateRelevance(int clientIdx)
+{
+    ServerPlayer &serverPlayer = players[clientIdx];
+    Entity *viewer = entityDb->FindEntity(serverPlayer.entityId);
+    if (!viewer) {
+        return;
+    }
+
+    // Leave: anything we told them about that's gone now, or that they've moved away from
+    for (auto iter = serverPlayer.relevantEntities.begin(); iter != serverPlayer.relevantEntities.end();) {
+        const uint32_t entityId = *iter;
+        Entity *entity = entityDb->FindEntity(entityId);
+        if ((!entity || !IsRelevant(*viewer, *entity, true)) && SendEntityDespawn(clientIdx, entityId)) {
+            iter = serverPlayer.relevantEntities.erase(iter);
+            serverPlayer.relevantHash -= EntityIdHash(entityId);
+        } else {
+            iter++;
+        }
+    }
+
+    // Enter
+    const Vector2 viewerPos{ viewer->position.x, viewer->position.y };
+    entityDb->QueryRadius(viewer->map_id, viewerPos, SV_RELEVANCE_RADIUS, nearbyEntities);
+    for (Entity *entityPtr : nearbyEntities) {
+        Entity &entity = *entityPtr;
+        if (!entity.id || !entity.type) {
+            continue;
+        }
+        if (serverPlayer.relevantEntities.contains(entity.id)) {
+            continue;
+        }
+        if (IsRelevant(*viewer, entity, false) && SendEntitySpawn(clientIdx, entity.id)) {
+            serverPlayer.relevantEntities.insert(entity.id);
+            serverPlayer.relevantHash += EntityIdHash(entity.id);
+        }
+    }
+}
+NetBounds GameServer::WorldNetBounds(void)
+{
+    NetBounds bounds{};
+    for (const Tilemap &map : pack_maps.tile_maps) {
+        bounds.world_w = MAX(bounds.world_w, map.width);
+        bounds.world_h = MAX(bounds.world_h, map.height);
+    }
+    return bounds;
+}
+void GameServer::SerializeSnapshot(Entity &entity, EntityNetState &state)
+{
     // Entity
-    entitySnapshot.entity_id = entity.id;
-    entitySnapshot.type      = entity.type;
-    entitySnapshot.map_id    = entity.map_id;
-    entitySnapshot.position  = entity.position;
-    entitySnapshot.on_warp_cooldown = entity.on_warp_cooldown;
+    state.type     = entity.type;
+    state.spec     = entity.spec;
+    state.map_id   = entity.map_id;
+    state.position = entity.position;
+    state.on_warp_cooldown = entity.on_warp_cooldown;
 
     // Collision
-    //entitySnapshot.radius = entity.radius;
+    //state.radius = entity.radius;
 
     // Life
-    entitySnapshot.hp_max = entity.hp_max;
-    entitySnapshot.hp     = entity.hp;
+    state.hp_max = entity.hp_max;
+    state.hp     = entity.hp;
 
     // Physics
-    //entitySnapshot.drag     = entity.drag;
-    //entitySnapshot.speed    = entity.speed;
-    entitySnapshot.velocity = entity.velocity;
+    //state.drag     = entity.drag;
+    //state.speed    = entity.speed;
+    state.velocity = entity.velocity;
+}
+void GameServer::BuildSnapshotPayload(ServerPlayer &serverPlayer, const EntitySnapshotFrame *baseline, SnapshotPayload &payload)
+{
+    EntitySnapshotFrame &frame = payload.frame;
+    frame.tick = tick;
+    frame.complete = true;
+
+    // Gather everything that changed since the baseline
+    std::vector<SnapshotCandidate> &candidates = snapshotCandidates;
+    candidates.clear();
+
+    for (uint32_t entityId : serverPlayer.relevantEntities) {
+        Entity *entity = entityDb->FindEntity(entityId);
+        if (!entity) {
+            continue;
+        }
+
+        SnapshotCandidate candidate{};
+        candidate.record.entity_id = entityId;
+        SerializeSnapshot(*entity, candidate.record.state);
+        candidate.record.state.Quantize(snapshotBounds);
+
+        const EntityNetState *base = baseline ? baseline->Find(entityId) : 0;
+        candidate.record.fields = base ? base->Diff(candidate.record.state) : EntityNetState::FIELD_ALL;
+        if (candidate.record.fields) {
+            candidates.push_back(candidate);
+        }
+    }
+
+    // Anything still in the baseline that no longer exists (or they can't see anymore) is gone
+    if (baseline) {
+        for (const EntitySnapshotEntry &base : baseline->entities) {
+            if (!serverPlayer.relevantEntities.contains(base.entity_id) || !entityDb->FindEntity(base.entity_id)) {
+                SnapshotCandidate candidate{};
+                candidate.record.entity_id = base.entity_id;
+                candidate.record.removed = true;
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    int totalBits = 0;
+    for (SnapshotCandidate &candidate : candidates) {
+        yojimbo::MeasureStream measure{ yojimbo::GetDefaultAllocator() };
+        candidate.record.Serialize(measure, snapshotBounds);
+        candidate.bits = measure.GetBitsProcessed();
+        totalBits += candidate.bits;
+    }
+
+    const int budgetBits = SV_SNAPSHOT_BUDGET_BYTES * 8;
+    if (totalBits > budgetBits) {
+        // Doesn't all fit. Send what matters most to this player first, and let everything else
+        // build up priority so it can't be starved forever.
+        Entity *player = entityDb->FindEntity(serverPlayer.entityId);
+        for (SnapshotCandidate &candidate : candidates) {
+            float weight = 1.0f;
+            if (candidate.record.entity_id == serverPlayer.entityId) {
+                weight = FLT_MAX;
+            } else if (candidate.record.removed) {
+                weight = 2.0f;  // cheap, and ghosts of dead things look dumb
+            } else if (player) {
+                const EntityNetState &state = candidate.record.state;
+                if (state.map_id == player->map_id) {
+                    const float distSq = Vector3DistanceSqr(state.position, player->position);
+                    weight = 1.0f / (1.0f + distSq / (SV_SNAPSHOT_PRIORITY_DIST * SV_SNAPSHOT_PRIORITY_DIST));
+                } else {
+                    weight = 0.01f;
+                }
+            }
+            float &accum = serverPlayer.snapshotPriority[candidate.record.entity_id];
+            accum = MIN(accum + weight, FLT_MAX);
+            candidate.priority = accum;
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const SnapshotCandidate &a, const SnapshotCandidate &b) { return a.priority > b.priority; }
+        );
+    }
+
+    std::vector<EntitySnapshotRecord> &sent = snapshotSentRecords;
+    sent.clear();
+    yojimbo::WriteStream stream{ yojimbo::GetDefaultAllocator(), payload.data, sizeof(payload.data) };
+    int bitsLeft = budgetBits;
+    for (SnapshotCandidate &candidate : candidates) {
+        if (candidate.bits > bitsLeft) {
+            // Leave it out of the frame too, so it's still a delta next time
+            frame.complete = false;
+            continue;
+        }
+        candidate.record.Serialize(stream, snapshotBounds);
+        bitsLeft -= candidate.bits;
+        payload.entity_count++;
+
+        sent.push_back(candidate.record);
+        serverPlayer.snapshotPriority.erase(candidate.record.entity_id);
+    }
+    stream.Flush();
+    payload.size = (stream.GetBytesProcessed() + 3) & ~3;
+
+    // What the client will have once it applies this, i.e. the baseline with what we sent on top
+    std::sort(sent.begin(), sent.end(),
+        [](const EntitySnapshotRecord &a, const EntitySnapshotRecord &b) { return a.entity_id < b.entity_id; }
+    );
+    frame.Merge(baseline, sent.data(), sent.size());
+}
+void GameServer::SendWorldSnapshot(int clientIdx)
+{
+    ServerPlayer &serverPlayer = players[clientIdx];
+
+    // Entity state is delta-encoded against the newest snapshot the client has acked, so
+    // entities that haven't changed since then cost nothing.
+    EntitySnapshotFrame *baseline = 0;
+    if (serverPlayer.snapshotAcked && tick - serverPlayer.snapshotAcked <= SV_SNAPSHOT_MAX_BASELINE_AGE) {
+        baseline = FindSnapshotFrame(serverPlayer.snapshotHistory, serverPlayer.snapshotAcked);
+    }
+    const uint32_t baselineTick = baseline ? baseline->tick : 0;
+
+    // A complete frame is exactly the state of the relevant entities as of its tick, so every
+    // client whose baseline is a complete frame of the same tick and entities (or who has no
+    // baseline), and who can see the same entities now, gets the exact same records.
+    const bool shareable = !baseline || baseline->complete;
+    const uint64_t shareKey = hash_combine(baselineTick, baseline ? baseline->id_set_hash : 0, serverPlayer.relevantHash);
+
+    SnapshotPayload *payload = 0;
+    if (shareable) {
+        const auto &cached = snapshotPayloads.find(shareKey);
+        if (cached != snapshotPayloads.end()) {
+            payload = &cached->second;
+            serverPlayer.snapshotPriority.clear();  // everything fit, nothing left waiting
+            snapshotsShared++;
+        }
+    }
+    if (!payload) {
+        // NOTE(dlb): Keep the frame's entities around, Merge reuses their memory
+        snapshotScratch.frame.tick = 0;
+        snapshotScratch.frame.complete = false;
+        snapshotScratch.entity_count = 0;
+        snapshotScratch.size = 0;
+        BuildSnapshotPayload(serverPlayer, baseline, snapshotScratch);
+        payload = &snapshotScratch;
+        if (shareable && snapshotScratch.frame.complete) {
+            payload = &(snapshotPayloads[shareKey] = snapshotScratch);
+        }
+    }
+
+    if (yj_server->CanSendMessage(clientIdx, CHANNEL_U_ENTITY_SNAPSHOT)) {
+        Msg_S_WorldSnapshot *msg = (Msg_S_WorldSnapshot *)yj_server->CreateMessage(clientIdx, MSG_S_WORLD_SNAPSHOT);
+        if (msg) {
+            msg->server_time   = lastTickedAt;
+            msg->tick          = payload->frame.tick;
+            msg->baseline_tick = baselineTick;
+            msg->entity_count  = payload->entity_count;
+            msg->bounds        = snapshotBounds;
+            msg->last_processed_input_cmd = serverPlayer.lastInputSeq;
+            uint8_t *block = 0;
+            if (payload->size) {
+                block = yj_server->AllocateBlock(clientIdx, payload->size);
+                if (block) {
+                    memcpy(block, payload->data, payload->size);
+                    yj_server->AttachBlockToMessage(clientIdx, msg, block, payload->size);
+                }
+            }
+            if (block || !payload->size) {
+                yj_server->SendMessage(clientIdx, CHANNEL_U_ENTITY_SNAPSHOT, msg);
+                snapshotsSent++;
+            } else {
+                printf("[game_server] failed to allocate %u byte world snapshot block for client %d\n", payload->size, clientIdx);
+                yj_server->ReleaseMessage(clientIdx, msg);
+            }
+        }
+    }
+
+    // NOTE(dlb): Remember it even if we couldn't send it, the client just won't ever ack it
+    serverPlayer.snapshotHistory.push(payload->frame);
 }
 void GameServer::SendClientSnapshots(void)
 {
+    snapshotPayloads.clear();
+    snapshotBounds = WorldNetBounds();
+
     for (int clientIdx = 0; clientIdx < SV_MAX_PLAYERS; clientIdx++) {
         if (!yj_server->IsClientConnected(clientIdx)) {
             continue;
@@ -1291,69 +1833,33 @@ void GameServer::SendClientSnapshots(void)
 
         Tilemap &map = pack_maps.FindById<Tilemap>(entity->map_id);
 
-        const bool fullSnapshot = serverPlayer.joinedAt == now;
-
-        if (fullSnapshot || serverPlayer.needsChunkSync) {
-#if 0
-            // TODO: Send a full chunk resync only when it makes sense (first login, change maps, changes > N, etc.)
-            for (int tileChunkIdx = 0; tileChunkIdx < serverPlayer.chunkList.size(); tileChunkIdx++) {
-                TileChunkRecord &chunkRec = serverPlayer.chunkList[tileChunkIdx];
-                if (chunkRec.lastSentAt < map->chunkLastUpdatedAt) {
-                    SendTileChunk(clientIdx, *map, chunkRec.coord.x, chunkRec.coord.y);
-                    chunkRec.lastSentAt = now;
-                    printf("[game_server] sending chunk to client\n");
-                }
-            }
-#else
-            SendTileChunk(clientIdx, map, 0, 0);
-            serverPlayer.needsChunkSync = false;
-            printf("[game_server] sending map '%s' chunk to client\n", map.title.c_str());
-#endif
-        }
-
-        for (const Tilemap::Coord &coord : map.dirtyTiles) {
-            SendTileUpdate(clientIdx, map, coord.x, coord.y);
-        }
-
-        // TODO: Send only the world state that's relevant to this particular client
-        for (Entity &entity : entityDb->entities) {
-            if (!entity.id || !entity.type || entity.despawned_at) {
+        // Tiles that changed this tick, one message per chunk, for chunks the client was up to date
+        // on. Chunks they don't have (or that changed while they were elsewhere, or changed too
+        // much to be worth a delta) get sent whole by StreamTileChunks.
+        for (uint32_t chunkIdx : map.dirtyChunks) {
+            const TileChunk &chunk = map.chunks[chunkIdx];
+            const uint64_t key = TileChunkKey(map.id, chunkIdx % map.chunksW, chunkIdx / map.chunksW);
+            const auto sent = serverPlayer.chunkVersions.find(key);
+            if (sent == serverPlayer.chunkVersions.end() || sent->second != chunk.cleanVersion) {
                 continue;
             }
 
-            const bool owner = entity.id == serverPlayer.entityId;
-
-            if (fullSnapshot) {
-                if (yj_server->CanSendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT)) {
-                    Msg_S_EntitySpawn *msg = (Msg_S_EntitySpawn *)yj_server->CreateMessage(clientIdx, MSG_S_ENTITY_SPAWN);
-                    if (msg) {
-                        SerializeSpawn(entity.id, *msg);
-                        // TODO: MSG_S_ACK_INPUT as unrealible msg? (keep max on receiving end)
-                        if (owner) {
-                            msg->last_processed_input_cmd = serverPlayer.lastInputSeq;
-                        }
-                        yj_server->SendMessage(clientIdx, CHANNEL_R_ENTITY_EVENT, msg);
-                    }
-                }
-            }
-
-            if (owner || entity.Active(now)) {
-                if (yj_server->CanSendMessage(clientIdx, CHANNEL_U_ENTITY_SNAPSHOT)) {
-                    Msg_S_EntitySnapshot *msg = (Msg_S_EntitySnapshot *)yj_server->CreateMessage(clientIdx, MSG_S_ENTITY_SNAPSHOT);
-                    if (msg) {
-                        SerializeSnapshot(entity, *msg);
-                        if (owner) {
-                            msg->last_processed_input_cmd = serverPlayer.lastInputSeq;
-                        }
-                        yj_server->SendMessage(clientIdx, CHANNEL_U_ENTITY_SNAPSHOT, msg);
-                    }
-                }
+            if (SendTileDelta(clientIdx, map, chunkIdx)) {
+                sent->second = chunk.version;
+            } else {
+                // Too big or couldn't fit it, resend the whole chunk later instead
+                serverPlayer.chunkVersions.erase(sent);
             }
         }
+
+        StreamTileChunks(clientIdx, map, *entity);
+
+        UpdateRelevance(clientIdx);
+        SendWorldSnapshot(clientIdx);
     }
 
     for (Tilemap &map : pack_maps.tile_maps) {
-        map.dirtyTiles.clear();
+        map.ClearDirtyTiles();
     }
 }
 void GameServer::SendClockSync(void)
@@ -1367,7 +1873,7 @@ void GameServer::SendClockSync(void)
         if (serverPlayer.needsClockSync && yj_server->CanSendMessage(clientIdx, CHANNEL_R_CLOCK_SYNC)) {
             Msg_S_ClockSync *msg = (Msg_S_ClockSync *)yj_server->CreateMessage(clientIdx, MSG_S_CLOCK_SYNC);
             if (msg) {
-                msg->serverTime = GetTime();
+                msg->serverTime = now;
                 msg->playerEntityId = serverPlayer.entityId;
                 yj_server->SendMessage(clientIdx, CHANNEL_R_CLOCK_SYNC, msg);
                 serverPlayer.needsClockSync = false;
@@ -4,6 +4,8 @@
 #include "../common/entity_db.h"
 #include "../common/input_command.h"
 #include "../common/net/net.h"
+#include "../common/tile_codec.h"
+#include "path_service.h"
 
 // Q: when the player goes to a new level, they see all the wrong entities
 // A: entities needs to be scoped by level
@@ -31,12 +33,6 @@
 //    - Use C instead of C++? No.
 //    - Use std::variant. No. Fuck that.
 
-struct TileChunkRecord {
-    uint16_t map_id{};
-    Tilemap::Coord coord{};
-    double lastSentAt{};  // when we last sent this chunk to the client
-};
-
 struct ServerPlayer {
     //uint32_t clientIdx      {};  // yj_client index
     double   joinedAt       {};
@@ -44,9 +40,43 @@ struct ServerPlayer {
     uint32_t entityId       {};
     uint8_t  lastInputSeq   {};  // sequence number of last input command we processed
     RingBuffer<InputCmd, CL_SEND_INPUT_COUNT> inputQueue{};
-    // TODO(dlb): Also send tile chunks whenever a client enters the render distance of it
-    bool     needsChunkSync {};
-    RingBuffer<TileChunkRecord, CL_RENDER_DISTANCE*CL_RENDER_DISTANCE> chunkList{};
+    std::unordered_map<uint64_t, uint32_t> chunkVersions{};  // (map_id, chunk x/y) -> TileChunk::version the client has
+    uint32_t        snapshotAcked   {};  // newest snapshot tick the client says it received in full
+    SnapshotHistory snapshotHistory {};  // entity state as of recent snapshots we sent, baselines for deltas
+    std::unordered_map<uint32_t, float> snapshotPriority{};  // entity id -> priority accumulated while it didn't fit in a snapshot
+    std::unordered_set<uint32_t> relevantEntities{};  // entities this client has been sent a spawn for, and gets snapshots of
+    uint64_t                     relevantHash{};      // hash of relevantEntities, see EntityIdHash
+};
+
+// The serialized entity records of a world snapshot, along with the frame the client will end
+// up with once it applies them.
+struct SnapshotPayload {
+    EntitySnapshotFrame frame        {};
+    uint32_t            entity_count {};  // # of EntitySnapshotRecords in data
+    uint32_t            size         {};  // bytes of data in use, padded to a multiple of 4 for yojimbo's bit reader
+    uint8_t             data         [SV_SNAPSHOT_BUDGET_BYTES]{};
+};
+
+struct TileChunkPayload {
+    uint32_t             version   {};  // TileChunk::version the tiles were compressed from
+    uint16_t             w         {};  // chunk size in tiles (smaller than TileChunk::WIDTH at the map's right/bottom edge)
+    uint16_t             h         {};
+    uint32_t             beeg_size {};  // uncompressed size
+    std::vector<uint8_t> smol      {};  // compressed tiles, copied into each client's message block
+};
+
+struct TileDeltaPayload {
+    uint32_t              cleanVersion {};  // TileChunk::cleanVersion/version the delta goes from/to
+    uint32_t              version      {};
+    uint16_t              tile_count   {};  // # of dirty tiles, data is left empty if there are too many to send
+    uint16_t              run_count    {};
+    std::vector<uint16_t> data         {};  // Msg_S_TileDelta block
+};
+
+struct SnapshotCandidate {
+    EntitySnapshotRecord record   {};
+    int                  bits     {};
+    float                priority {};
 };
 
 class GameServerNetAdapter : public NetAdapter
@@ -81,6 +111,16 @@ struct GameServer {
     double tickAccum{};
     double lastTickedAt{};
 
+    // Tick scheduler stats
+    double   tickLateness{};     // how long after its deadline the last tick started
+    double   tickLatenessMax{};
+    double   tickDuration{};     // how long the last tick took to simulate
+    uint64_t tickOverruns{};     // ticks that took longer than SV_TICK_DT to simulate
+    uint64_t ticksDropped{};     // ticks skipped because we fell more than SV_TICK_MAX_CATCHUP behind
+    double   tickReportedAt{};   // last time overruns/drops were printed, at most once a second
+    uint64_t tickOverrunsReported{};
+    uint64_t ticksDroppedReported{};
+
     double frameStart{};
     double frameDt{};
     double frameDtSmooth = 60;
@@ -91,14 +131,39 @@ struct GameServer {
     Rectangle lastCollisionA{};
     Rectangle lastCollisionB{};
 
-    uint32_t nextEntityId = 1;
-
     double lastTownfolkSpawnedAt{};
     double lastChickenSpawnedAt{};
     uint32_t eid_bots[1]{};
 
     ProtoDb protoDb{};
 
+    // Snapshot payloads built this tick, keyed by baseline tick and which entities are relevant,
+    // so clients that acked the same complete snapshot and can see the same things share one
+    // serialization
+    std::unordered_map<uint64_t, SnapshotPayload> snapshotPayloads{};
+    SnapshotPayload                snapshotScratch{};     // payload for clients that can't share
+    NetBounds                      snapshotBounds{};      // what this tick's snapshots are quantized to
+    std::vector<SnapshotCandidate> snapshotCandidates{};  // scratch for BuildSnapshotPayload
+    std::vector<EntitySnapshotRecord> snapshotSentRecords{};  // scratch for BuildSnapshotPayload, records that fit
+    std::vector<Entity *>          nearbyEntities{};      // scratch for EntityDB spatial queries
+    std::unordered_map<uint32_t, std::vector<Entity *>> tickBatches{};  // scratch, live entities by map for EntityTickBatch
+    // (map_id, chunk x/y) -> compressed tiles, shared by every client until the chunk changes
+    std::unordered_map<uint64_t, TileChunkPayload> tileChunkPayloads{};
+    TileCodec tileCodec{};
+    std::vector<uint8_t> tileChunkScratch{};  // encoded (but not yet compressed) tiles for BuildTileChunkPayload
+    // (map_id, chunk x/y) -> tiles changed since the last snapshot, shared by every client that
+    // was up to date on the chunk
+    std::unordered_map<uint64_t, TileDeltaPayload> tileDeltaPayloads{};
+    uint64_t snapshotsSent{};
+    uint64_t snapshotsShared{};  // # of snapshots sent that reused another client's payload
+    uint64_t tileChunksSent{};
+    uint64_t tileChunksCompressed{};  // # of tile chunk payloads built, the rest of tileChunksSent were cached
+    uint64_t tileDeltasSent{};
+    uint64_t tileDeltasResent{};  // # of tile deltas with too many tiles that fell back to resending the chunk
+
+    PathService pathService{};
+    std::vector<PathResult> pathResults{};  // scratch, paths delivered this tick
+
     GameServer(double now) : now(now), frameStart(now) {};
 
     void OnClientJoin(int clientIdx);
@@ -109,7 +174,9 @@ struct GameServer {
 
     void LoadProtos(void);  // TODO: Move to pack file
     Err Start(void);
+    void PumpNetwork(void);
     void Update(void);
+    void WaitForNextTick(void);
     void Stop(void);
 
 private:
@@ -124,26 +191,28 @@ private:
     void TickSpawnTownNPCs(uint16_t map_id);
     void TickSpawnCaveNPCs(uint16_t map_id);
     void TickEntityNPC(Entity &entity, double dt, double now);
-    void TickEntityPlayer(Entity &entity, double dt, double now);
+    void TickPathResult(const PathResult &result);
     void TickEntityProjectile(Entity &entity, double dt, double now);
     void TickResolveEntityWarpCollisions(Tilemap &map, Entity &entity);
     void Tick(void);
 
     void SerializeSpawn(uint32_t entityId, Msg_S_EntitySpawn &entitySpawn);
-    void SendEntitySpawn(int clientIdx, uint32_t entityId);
+    bool SendEntitySpawn(int clientIdx, uint32_t entityId);
     void BroadcastEntitySpawn(uint32_t entityId);
 
-    void SendEntityDespawn(int clientIdx, uint32_t entityId);
+    bool SendEntityDespawn(int clientIdx, uint32_t entityId);
     void BroadcastEntityDespawn(uint32_t entityId);
 
     void SendEntitySay(int clientIdx, uint32_t entityId, uint16_t dialogId, const std::string &title, const std::string &message);
     void BroadcastEntitySay(uint32_t entityId, const std::string &title, const std::string &message);
 
-    void SendTileChunk(int clientIdx, Tilemap &map, uint16_t x, uint16_t y);
-    void BroadcastTileChunk(Tilemap &map, uint16_t x, uint16_t y);
+    const TileChunkPayload &BuildTileChunkPayload(Tilemap &map, uint16_t chunk_x, uint16_t chunk_y);
+    bool SendTileChunk(int clientIdx, Tilemap &map, uint16_t chunk_x, uint16_t chunk_y);
+    void BroadcastTileChunk(Tilemap &map, uint16_t chunk_x, uint16_t chunk_y);
+    void StreamTileChunks(int clientIdx, Tilemap &map, Entity &player);
 
-    void SendTileUpdate(int clientIdx, Tilemap &map, uint16_t x, uint16_t y);
-    void BroadcastTileUpdate(Tilemap &map, uint16_t x, uint16_t y);
+    const TileDeltaPayload &BuildTileDeltaPayload(Tilemap &map, uint32_t chunkIdx);
+    bool SendTileDelta(int clientIdx, Tilemap &map, uint32_t chunkIdx);
 
     void SendTitleShow(int clientIdx, const std::string &text);
 
@@ -156,7 +225,13 @@ private:
     void ProcessMsg(int clientIdx, Msg_C_TileInteract &msg);
     void ProcessMessages(void);
 
-    void SerializeSnapshot(Entity &entity, Msg_S_EntitySnapshot &entitySnapshot);
+    bool IsRelevant(const Entity &viewer, const Entity &entity, bool wasRelevant);
+    void UpdateRelevance(int clientIdx);
+
+    NetBounds WorldNetBounds(void);
+    void SerializeSnapshot(Entity &entity, EntityNetState &state);
+    void BuildSnapshotPayload(ServerPlayer &serverPlayer, const EntitySnapshotFrame *baseline, SnapshotPayload &payload);
+    void SendWorldSnapshot(int clientIdx);
     void SendClientSnapshots(void);
     void SendClockSync(void);
 };
@@ -0,0 +1,372 @@
+#include "path_service.h"
+
+static_assert(HPA_CLUSTER_W == TileChunk::WIDTH, "clusters are indexed like chunks (see WorkerRebuildHpa)");
+
+Hpa_SolidView PathGrid::View(void) const
+{
+    return { bits.data(), stride, width, height };
+}
+
+PathCacheKey::PathCacheKey(uint16_t map_id, Vector2 start, Vector2 target, float radius)
+    : map_id(map_id), start_x((uint16_t)start.x), start_y((uint16_t)start.y),
+      target_x((uint16_t)target.x), target_y((uint16_t)target.y), radius(radius)
+{}
+
+void PathService::Start(void)
+{
+    assert(workers.empty());
+    quit = false;
+
+    // Leave a core for the tick thread
+    const int cores = std::thread::hardware_concurrency();
+    const int workerCount = CLAMP(cores - 1, 1, SV_PATH_WORKERS);
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&PathService::WorkerMain, this);
+    }
+    printf("[path_service] started %d workers\n", workerCount);
+}
+void PathService::Stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        queue.clear();
+        rebuildQueue.clear();
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    finished.clear();
+    rebuilt.clear();
+    pending.clear();
+    inFlight.clear();
+    grids.clear();
+    hpaGraphs.clear();
+    hpaRebuilding.clear();
+    cacheResults.clear();
+    cacheLru.clear();
+    cacheIndex.clear();
+}
+
+std::shared_ptr<const PathGrid> PathService::SnapshotGrid(Tilemap &map)
+{
+    map.SolidRow(-1);  // rebuild solidBits if it's stale
+
+    std::shared_ptr<const PathGrid> &grid = grids[map.id];
+    if (!grid || grid->solidVersion != map.solidVersion || grid->width != map.width || grid->height != map.height) {
+        std::shared_ptr<PathGrid> newGrid = std::make_shared<PathGrid>();
+        newGrid->map_id = map.id;
+        newGrid->solidVersion = map.solidVersion;
+        newGrid->width = map.width;
+        newGrid->height = map.height;
+        newGrid->stride = map.solidBitsStride;
+        newGrid->bits = map.solidBits;
+        newGrid->chunkSolidVersions.resize(map.chunks.size());
+        for (size_t chunkIdx = 0; chunkIdx < map.chunks.size(); chunkIdx++) {
+            newGrid->chunkSolidVersions[chunkIdx] = map.chunks[chunkIdx].solidVersion;
+        }
+
+        // NOTE(dlb): Requests still in flight keep their old grid alive until they finish
+        grid = newGrid;
+        RebuildHpa(map.id);
+    }
+    return grid;
+}
+void PathService::RebuildHpa(uint16_t map_id)
+{
+    // One rebuild per map at a time, Tick starts the next one (from the latest grid) when it's done
+    if (hpaRebuilding.contains(map_id)) {
+        return;
+    }
+    PathHpaRebuild rebuild{};
+    rebuild.grid = grids[map_id];
+    const auto hpaIter = hpaGraphs.find(map_id);
+    if (hpaIter != hpaGraphs.end()) {
+        rebuild.prev = hpaIter->second;
+        if (rebuild.prev->grid == rebuild.grid) {
+            return;  // already up to date
+        }
+    }
+    hpaRebuilding.insert(map_id);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rebuildQueue.push_back(std::move(rebuild));
+    }
+    wake.notify_one();
+}
+void PathService::Prepare(Tilemap &map)
+{
+    SnapshotGrid(map);
+}
+
+bool PathService::FindCachedPath(const PathCacheKey &key, uint32_t solidVersion, std::vector<Vector2> &path)
+{
+    const auto cacheIter = cacheIndex.find(key);
+    if (cacheIter == cacheIndex.end()) {
+        return false;
+    }
+    const auto entry = cacheIter->second;
+    if (entry->solidVersion != solidVersion) {
+        // Map changed since, the path might go through a wall now (or there's a shorter one)
+        cacheStale++;
+        cacheIndex.erase(cacheIter);
+        cacheLru.erase(entry);
+        return false;
+    }
+    cacheLru.splice(cacheLru.begin(), cacheLru, entry);
+    path = entry->path;
+    return true;
+}
+void PathService::CachePath(const PathResult &result)
+{
+    std::list<PathCacheEntry>::iterator entry{};
+    const auto cacheIter = cacheIndex.find(result.key);
+    if (cacheIter != cacheIndex.end()) {
+        entry = cacheIter->second;
+        if (entry->solidVersion > result.solidVersion) {
+            return;  // already have a newer one
+        }
+    } else if (cacheLru.size() >= SV_PATH_CACHE_SIZE) {
+        // Reuse the least recently used entry
+        entry = std::prev(cacheLru.end());
+        cacheIndex.erase(entry->key);
+        cacheIndex[result.key] = entry;
+        cacheEvictions++;
+    } else {
+        cacheLru.emplace_front();
+        entry = cacheLru.begin();
+        cacheIndex[result.key] = entry;
+    }
+    cacheLru.splice(cacheLru.begin(), cacheLru, entry);
+    entry->key = result.key;
+    entry->solidVersion = result.solidVersion;
+    entry->path = result.path;
+}
+
+bool PathService::Request(Tilemap &map, uint32_t entity_id, Vector2 start, Vector2 target, float radius)
+{
+    Cancel(entity_id);
+
+    const PathCacheKey key{ map.id, start, target, radius };
+    PathResult cached{};
+    if (FindCachedPath(key, map.solidVersion, cached.path)) {
+        cacheHits++;
+        cached.id = ++nextId;
+        cached.entity_id = entity_id;
+        cached.map_id = map.id;
+        cached.key = key;
+        cached.solidVersion = map.solidVersion;
+        inFlight[entity_id] = cached.id;
+        cacheResults.push_back(std::move(cached));
+        requested++;
+        return true;
+    }
+    cacheMisses++;
+
+    if (pending.size() >= SV_PATH_MAX_PENDING) {
+        dropped++;
+        return false;
+    }
+
+    PathRequest request{};
+    request.id = ++nextId;
+    request.entity_id = entity_id;
+    request.key = key;
+    request.grid = SnapshotGrid(map);
+    const auto hpaIter = hpaGraphs.find(map.id);
+    if (hpaIter != hpaGraphs.end()) {
+        request.hpa = hpaIter->second;
+    }
+    request.start = start;
+    request.target = target;
+    request.radius = radius;
+
+    inFlight[entity_id] = request.id;
+    pending.push_back(std::move(request));
+    requested++;
+    return true;
+}
+bool PathService::IsPending(uint32_t entity_id)
+{
+    return inFlight.contains(entity_id);
+}
+void PathService::Cancel(uint32_t entity_id)
+{
+    const auto inFlightIter = inFlight.find(entity_id);
+    if (inFlightIter == inFlight.end()) {
+        return;
+    }
+    const uint32_t id = inFlightIter->second;
+    inFlight.erase(inFlightIter);
+    cancelled++;
+
+    if (std::erase_if(cacheResults, [id](const PathResult &result) { return result.id == id; })) {
+        return;
+    }
+    const auto isCancelled = [id](const PathRequest &request) { return request.id == id; };
+    if (std::erase_if(pending, isCancelled)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::erase_if(queue, isCancelled);
+    }
+    // Otherwise a worker already has it, the result gets thrown away when it comes back
+}
+size_t PathService::PendingCount(void)
+{
+    return inFlight.size();
+}
+
+void PathService::Tick(std::vector<PathResult> &results)
+{
+    std::vector<std::shared_ptr<const PathHpaGraph>> hpaBuilt{};
+    results.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.swap(finished);
+        hpaBuilt.swap(rebuilt);
+    }
+
+    // Requests made from now on search the new graphs. If the map changed again while one was
+    // being built, start on the next one.
+    for (std::shared_ptr<const PathHpaGraph> &hpa : hpaBuilt) {
+        const uint16_t map_id = hpa->grid->map_id;
+        hpaRebuilds++;
+        hpaRebuildTime = hpa->buildTime;
+        hpaGraphs[map_id] = std::move(hpa);
+        hpaRebuilding.erase(map_id);
+        RebuildHpa(map_id);
+    }
+
+    // NOTE(dlb): Cache everything the workers found, even if it was cancelled in the meantime
+    tickSearchTime = 0;
+    for (const PathResult &result : results) {
+        tickSearchTime += result.searchTime;
+        CachePath(result);
+    }
+    for (PathResult &cached : cacheResults) {
+        results.push_back(std::move(cached));
+    }
+    cacheResults.clear();
+
+    size_t delivered = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        PathResult &result = results[i];
+
+        // Only deliver the entity's latest request, anything else was cancelled while in flight
+        const auto inFlightIter = inFlight.find(result.entity_id);
+        if (inFlightIter == inFlight.end() || inFlightIter->second != result.id) {
+            continue;
+        }
+        inFlight.erase(inFlightIter);
+        if (delivered != i) {
+            results[delivered] = std::move(result);
+        }
+        delivered++;
+    }
+    results.resize(delivered);
+    solved += delivered;
+
+    // The workers share the CPU with the tick thread, so they get SV_PATH_TICK_BUDGET of search
+    // time per tick. Searches that ran long put the budget in debt, and nothing new is handed out
+    // until it's paid off.
+    budget = MIN(budget + SV_PATH_TICK_BUDGET, SV_PATH_TICK_BUDGET) - tickSearchTime;
+
+    int dispatched = 0;
+    if (budget > 0 && !pending.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!pending.empty() && dispatched < SV_PATH_MAX_REQUESTS_PER_TICK) {
+                queue.push_back(std::move(pending.front()));
+                pending.pop_front();
+                dispatched++;
+            }
+        }
+        wake.notify_all();
+    }
+}
+
+void PathService::WorkerMain(void)
+{
+    for (;;) {
+        PathRequest request{};
+        PathHpaRebuild rebuild{};
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]{ return quit || !queue.empty() || !rebuildQueue.empty(); });
+            if (quit) {
+                return;
+            }
+            // Paths first, the graph for a big map can take a second to build from scratch
+            if (!queue.empty()) {
+                request = std::move(queue.front());
+                queue.pop_front();
+            } else {
+                rebuild = std::move(rebuildQueue.front());
+                rebuildQueue.pop_front();
+            }
+        }
+
+        if (rebuild.grid) {
+            WorkerRebuildHpa(rebuild);
+            continue;
+        }
+
+        PathResult result{};
+        const double startedAt = yojimbo_time();
+        const PathGrid *grid = request.grid.get();
+        const float dist = MAX(fabsf(request.target.x - request.start.x), fabsf(request.target.y - request.start.y));
+        // Anya alone explores way too much of the map (or gives up) on long trips, but it'll have
+        // to do until the map's first cluster graph is built
+        if (dist >= SV_PATH_HPA_MIN_DIST && request.hpa) {
+            grid = request.hpa->grid.get();
+            const Hpa_SolidView solid = grid->View();
+            Hpa_FindPath(request.hpa->graph, solid, request.start, request.target, request.radius, result.path);
+        } else {
+            const Hpa_SolidView solid = grid->View();
+            Anya_State &state = Anya_ThreadState();
+            state.Reset(request.start, request.target, Hpa_SolidView::AnyaSolidQuery, (void *)&solid);
+            Anya(state, request.radius);
+            result.path = state.path;
+        }
+
+        result.id = request.id;
+        result.entity_id = request.entity_id;
+        result.map_id = grid->map_id;
+        result.key = request.key;
+        result.solidVersion = grid->solidVersion;
+        result.searchTime = yojimbo_time() - startedAt;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(result));
+    }
+}
+void PathService::WorkerRebuildHpa(const PathHpaRebuild &rebuild)
+{
+    const double startedAt = yojimbo_time();
+    std::shared_ptr<PathHpaGraph> hpa = std::make_shared<PathHpaGraph>();
+    hpa->grid = rebuild.grid;
+
+    // Clusters are the same size as tile chunks, so only the ones in chunks whose solidity changed
+    // since the previous graph was built need checking. The rest are shared with it.
+    thread_local std::vector<uint32_t> changed{};
+    changed.clear();
+    if (rebuild.prev) {
+        hpa->graph = rebuild.prev->graph;
+        const uint32_t prevVersion = rebuild.prev->grid->solidVersion;
+        const std::vector<uint32_t> &chunkSolidVersions = rebuild.grid->chunkSolidVersions;
+        for (uint32_t chunkIdx = 0; chunkIdx < chunkSolidVersions.size(); chunkIdx++) {
+            if (chunkSolidVersions[chunkIdx] > prevVersion) {
+                changed.push_back(chunkIdx);
+            }
+        }
+    }
+    hpa->graph.Update(hpa->grid->View(), changed);
+    hpa->buildTime = yojimbo_time() - startedAt;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rebuilt.push_back(std::move(hpa));
+}
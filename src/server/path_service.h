@@ -0,0 +1,149 @@
+#pragma once
+#include "../common/common.h"
+#include "../common/hpa.h"
+#include "../common/tilemap.h"
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+// Copy of a map's solidity (Tilemap::solidBits) that's never modified once built, so the workers
+// can search it while the tick thread keeps changing the map. Shared by every request made while
+// the map's solidity didn't change.
+struct PathGrid {
+    uint16_t              map_id             {};
+    uint32_t              solidVersion       {};  // Tilemap::solidVersion it was copied at
+    uint16_t              width              {};
+    uint16_t              height             {};
+    uint32_t              stride             {};  // see Tilemap::solidBitsStride
+    std::vector<uint64_t> bits               {};
+    std::vector<uint32_t> chunkSolidVersions {};  // TileChunk::solidVersion of each of the map's chunks
+
+    Hpa_SolidView View(void) const;
+};
+
+// Cluster graph for long paths, built on a worker from one of the map's grids. Searched together
+// with that grid, which may be a few changes behind the latest one while the next graph's built.
+struct PathHpaGraph {
+    std::shared_ptr<const PathGrid> grid      {};
+    Hpa_Graph                       graph     {};
+    double                          buildTime {};
+};
+
+struct PathHpaRebuild {
+    std::shared_ptr<const PathGrid>     grid {};  // to build from
+    std::shared_ptr<const PathHpaGraph> prev {};  // map's latest graph (if any), only the clusters that changed since get rebuilt
+};
+
+struct PathCacheKey {
+    uint16_t map_id   {};
+    uint16_t start_x  {};  // tile coords
+    uint16_t start_y  {};
+    uint16_t target_x {};
+    uint16_t target_y {};
+    float    radius   {};
+
+    PathCacheKey(void) = default;
+    PathCacheKey(uint16_t map_id, Vector2 start, Vector2 target, float radius);
+
+    bool operator==(const PathCacheKey &other) const = default;
+
+    struct Hasher {
+        size_t operator()(const PathCacheKey &key) const
+        {
+            return hash_combine(key.map_id, key.start_x, key.start_y, key.target_x, key.target_y, key.radius);
+        }
+    };
+};
+
+struct PathCacheEntry {
+    PathCacheKey         key          {};
+    uint32_t             solidVersion {};  // Tilemap::solidVersion the path was found at, stale once the map's moves on
+    std::vector<Vector2> path         {};
+};
+
+struct PathRequest {
+    uint32_t                            id        {};
+    uint32_t                            entity_id {};
+    PathCacheKey                        key       {};
+    std::shared_ptr<const PathGrid>     grid      {};
+    std::shared_ptr<const PathHpaGraph> hpa       {};  // map's latest graph, null until the first one's built
+    Vector2                             start     {};  // tile coords
+    Vector2                             target    {};
+    float                               radius    {};
+};
+
+struct PathResult {
+    uint32_t             id           {};
+    uint32_t             entity_id    {};
+    uint16_t             map_id       {};
+    PathCacheKey         key          {};
+    uint32_t             solidVersion {};  // of the grid it was searched on
+    std::vector<Vector2> path         {};  // world coords (pixels, unlike start/target), empty if there's no path
+    double               searchTime   {};  // how long the worker spent on it, 0 if it came from the cache
+};
+
+// Solves Anya path requests on worker threads so long searches don't eat into the tick. Requests
+// are made and results come back on the tick thread, at most one request in flight per entity.
+// The workers also rebuild each map's cluster graph (see hpa.h) when its solidity changes.
+struct PathService {
+    uint64_t requested      {};
+    uint64_t solved         {};  // results delivered to the game
+    uint64_t cancelled      {};  // replaced or despawned before the result was delivered
+    uint64_t dropped        {};  // requests turned away because too many were pending
+    double   tickSearchTime {};  // search time of the results delivered last tick
+    double   budget         {};  // search time the workers may still spend, refilled every tick
+    uint64_t cacheHits      {};
+    uint64_t cacheMisses    {};
+    uint64_t cacheStale     {};  // misses where the path was cached, but the map's solidity changed since
+    uint64_t cacheEvictions {};
+    uint64_t hpaRebuilds    {};  // cluster graphs built
+    double   hpaRebuildTime {};  // how long the last one took
+
+    void Start(void);
+    void Stop(void);
+
+    // Starts building the map's cluster graph, so it's ready before the first long request
+    void Prepare(Tilemap &map);
+
+    // Searches from start to target (tile coords) against the map as it is now. Replaces the
+    // entity's previous request, returns false if the queue is full. Paths found recently for the
+    // same cells (and radius) come from the cache, they're still delivered by the next Tick.
+    bool Request(Tilemap &map, uint32_t entity_id, Vector2 start, Vector2 target, float radius);
+    bool IsPending(uint32_t entity_id);
+    void Cancel(uint32_t entity_id);
+    size_t PendingCount(void);
+
+    // Once per tick: replaces results with the paths that finished since the last call, then
+    // hands queued requests to the workers while there's budget left
+    void Tick(std::vector<PathResult> &results);
+
+private:
+    // Tick thread only
+    uint32_t nextId {};
+    std::deque<PathRequest> pending {};  // waiting for budget
+    std::unordered_map<uint32_t, uint32_t> inFlight {};  // entity id -> id of its request (pending or queued)
+    std::unordered_map<uint16_t, std::shared_ptr<const PathGrid>> grids {};  // map id -> latest solidity snapshot
+    std::unordered_map<uint16_t, std::shared_ptr<const PathHpaGraph>> hpaGraphs {};  // map id -> latest cluster graph built
+    std::unordered_set<uint16_t> hpaRebuilding {};  // map ids with a rebuild handed to the workers
+    std::vector<PathResult> cacheResults {};  // cache hits, delivered with the worker results next Tick
+    std::list<PathCacheEntry> cacheLru {};    // most recently used first, at most SV_PATH_CACHE_SIZE
+    std::unordered_map<PathCacheKey, std::list<PathCacheEntry>::iterator, PathCacheKey::Hasher> cacheIndex {};
+
+    // Shared with the workers
+    std::mutex mutex {};
+    std::condition_variable wake {};
+    bool quit {};
+    std::deque<PathRequest> queue {};  // handed to the workers, not started yet
+    std::vector<PathResult> finished {};
+    std::deque<PathHpaRebuild> rebuildQueue {};  // workers take these when there are no requests queued
+    std::vector<std::shared_ptr<const PathHpaGraph>> rebuilt {};
+    std::vector<std::thread> workers {};
+
+    std::shared_ptr<const PathGrid> SnapshotGrid(Tilemap &map);
+    void RebuildHpa(uint16_t map_id);
+    bool FindCachedPath(const PathCacheKey &key, uint32_t solidVersion, std::vector<Vector2> &path);
+    void CachePath(const PathResult &result);
+    void WorkerMain(void);
+    void WorkerRebuildHpa(const PathHpaRebuild &rebuild);
+};
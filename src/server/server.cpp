@@ -1,12 +1,15 @@
-#include "../common/boot_screen.h"
 #include "../common/collision.h"
 #include "../common/histogram.h"
 #include "../common/io.h"
 #include "../common/perf_timer.h"
 #include "../common/ui/ui.h"
+#include "game_server.h"
+#if !SV_HEADLESS
+#include "../common/boot_screen.h"
 #include "editor.h"
 #include "f3_menu.h"
-#include "game_server.h"
+#endif
+#include <csignal>
 
 const bool IS_SERVER = true;
 
@@ -48,6 +51,45 @@ void RN_TraceLogCallback(int logLevel, const char *text, va_list args)
     }
 }
 
+#if SV_HEADLESS
+#if _WIN32
+// NOTE(dlb): Without a window, nobody calls timeBeginPeriod() for us and Sleep() has ~15 ms
+// granularity. Declared here (like raylib does) to avoid dragging in windows.h.
+extern "C" __declspec(dllimport) unsigned int __stdcall timeBeginPeriod(unsigned int uPeriod);
+extern "C" __declspec(dllimport) unsigned int __stdcall timeEndPeriod(unsigned int uPeriod);
+#endif
+
+volatile sig_atomic_t quitRequested = 0;
+
+void RN_SignalHandler(int signal)
+{
+    quitRequested = 1;
+}
+
+Err Play(GameServer &server)
+{
+    Err err = RN_SUCCESS;
+
+    while (!quitRequested) {
+        server.frame++;
+        server.now = yojimbo_time();
+        const double elapsed = server.now - server.frameStart;
+        server.frameDt = MIN(elapsed, SV_TICK_DT * 3);  // arbitrary limit for now
+        server.frameDtSmooth = LERP(server.frameDtSmooth, server.frameDt, 0.1);
+        server.frameStart = server.now;
+        server.tickAccum += elapsed;  // Update() bounds the catch-up
+
+        if (server.tickAccum >= SV_TICK_DT) {
+            server.Update();
+        }
+
+        // Nothing to draw, so sleep until the next tick is due rather than spinning
+        server.WaitForNextTick();
+    }
+
+    return err;
+}
+#else
 void UpdateCamera(Camera2D &camera)
 {
     if (io.MouseButtonDown(MOUSE_BUTTON_RIGHT)) {
@@ -110,11 +152,12 @@ Err Play(GameServer &server)
         io.PushScope(IO::IO_Game);
 
         server.frame++;
-        server.now = GetTime();
-        server.frameDt = MIN(server.now - server.frameStart, SV_TICK_DT * 3);  // arbitrary limit for now
+        server.now = yojimbo_time();
+        const double elapsed = server.now - server.frameStart;
+        server.frameDt = MIN(elapsed, SV_TICK_DT * 3);  // arbitrary limit for now
         server.frameDtSmooth = LERP(server.frameDtSmooth, server.frameDt, 0.1);
         server.frameStart = server.now;
-        server.tickAccum += server.frameDt;
+        server.tickAccum += elapsed;  // Update() bounds the catch-up
 
 #if SV_RENDER
         // Global Input (ignores io stack; only for function keys)
@@ -223,7 +266,10 @@ Err Play(GameServer &server)
         BeginDrawing();
         EndDrawing();
 #endif
-        yojimbo_sleep(0.001);
+        if (!IsWindowState(FLAG_VSYNC_HINT)) {
+            // Nothing is pacing the render loop, don't spin faster than we tick
+            server.WaitForNextTick();
+        }
 
         if (WindowShouldClose() || io.KeyPressed(KEY_ESCAPE)) {
             // Nobody else handled it, so user probably wants to quit
@@ -236,6 +282,7 @@ Err Play(GameServer &server)
 
     return err;
 }
+#endif
 
 int main(int argc, char *argv[])
 //int __stdcall WinMain(void *hInstance, void *hPrevInstance, char *pCmdLine, int nCmdShow)
@@ -249,6 +296,16 @@ int main(int argc, char *argv[])
         SetTraceLogLevel(LOG_WARNING);
         SetTraceLogCallback(RN_TraceLogCallback);
 
+#if SV_HEADLESS
+        signal(SIGINT, RN_SignalHandler);
+        signal(SIGTERM, RN_SignalHandler);
+    #if _WIN32
+        timeBeginPeriod(1);
+    #endif
+
+        // NOTE(dlb): yojimbo uses rand() for network simulator and random_int()/random_float()
+        srand((unsigned int)time(0));
+#else
         {
             PerfTimer t{ "InitWindow" };
             InitWindow(1920, 1017, "RayNet Server");
@@ -271,6 +328,7 @@ int main(int argc, char *argv[])
 
         // NOTE(dlb): yojimbo uses rand() for network simulator and random_int()/random_float()
         srand((unsigned int)GetTime());
+#endif
 
         err = Init();
         if (err) {
@@ -278,6 +336,7 @@ int main(int argc, char *argv[])
             break;
         }
 
+#if !SV_HEADLESS
         Image icon = LoadImage("../res/server.png");
         SetWindowIcon(icon);
         UnloadImage(icon);
@@ -300,12 +359,20 @@ int main(int argc, char *argv[])
             monitor2.y + monitorHeight / 2 - (int)screenSize.y / 2
         );
     #endif
+#endif
+
+#if SV_DBG_BENCHMARKS
+        EntityDBBenchmark();
+        TilemapBenchmark();
+        TileCodecBenchmark();
+        HpaBenchmark();
+        FlowFieldBenchmark();
+#endif
 
-        double now = GetTime();
+        double now = yojimbo_time();
 
         //--------------------
         // Create server
-        // NOTE(DLB): MUST happen after InitWindow() so that GetTime() is valid!!
         server = new GameServer(now);
         if (!server) {
             printf("error: failed to allocate server\n");
@@ -349,14 +416,23 @@ int main(int argc, char *argv[])
     ShutdownYojimbo();
 
     Free();
+#if SV_HEADLESS
+    #if _WIN32
+    timeEndPeriod(1);
+    #endif
+#else
     CloseAudioDevice();
     CloseWindow();
+#endif
 
     return err;
 }
 
 #include "../common/common.cpp"
+#if !SV_HEADLESS
 #include "../common/boot_screen.cpp"
 #include "editor.cpp"
 #include "f3_menu.cpp"
-#include "game_server.cpp"
\ No newline at end of file
+#endif
+#include "game_server.cpp"
+#include "path_service.cpp"
\ No newline at end of file